@@ -0,0 +1,141 @@
+#include "BlockCompression.h"
+#include <glm/gtc/type_precision.hpp>
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+
+using Block = std::array<glm::u8vec4, 16>;
+
+static Block read_block(const uint8_t* rgba, glm::ivec2 size, int blockX, int blockY) {
+	Block block;
+	for(int y = 0; y < 4; y++) {
+		for(int x = 0; x < 4; x++) {
+			auto px = std::min(blockX * 4 + x, size.x - 1);
+			auto py = std::min(blockY * 4 + y, size.y - 1);
+			std::memcpy(&block[y * 4 + x], rgba + (static_cast<size_t>(py) * size.x + px) * 4, 4);
+		}
+	}
+
+	return block;
+}
+
+static uint16_t pack_565(glm::ivec3 color) {
+	return static_cast<uint16_t>((color.r >> 3) << 11 | (color.g >> 2) << 5 | (color.b >> 3));
+}
+
+static glm::ivec3 unpack_565(uint16_t color) {
+	glm::ivec3 c((color >> 11) & 31, (color >> 5) & 63, color & 31);
+	return { c.r << 3 | c.r >> 2, c.g << 2 | c.g >> 4, c.b << 3 | c.b >> 2 };
+}
+
+static void encode_color(const Block& block, uint8_t* out) {
+	glm::ivec3 min(255), max(0);
+	for(const auto& t : block) {
+		min = glm::min(min, glm::ivec3(t));
+		max = glm::max(max, glm::ivec3(t));
+	}
+
+	//Insetting the box by 1/16 of its size moves the endpoints towards the colors that are actually there
+	auto inset = (max - min) / 16;
+	auto color0 = pack_565(glm::clamp(max - inset, 0, 255));
+	auto color1 = pack_565(glm::clamp(min + inset, 0, 255));
+
+	//color0 > color1 selects the four color mode, equal endpoints leave every index at 0
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		auto c0 = unpack_565(color0), c1 = unpack_565(color1);
+		std::array<glm::ivec3, 4> palette { c0, c1, (2 * c0 + c1) / 3, (c0 + 2 * c1) / 3 };
+
+		for(int i = 0; i < 16; i++) {
+			uint32_t best = 0;
+			int bestDistance = INT32_MAX;
+			for(uint32_t p = 0; p < 4; p++) {
+				auto d = glm::ivec3(block[i]) - palette[p];
+				auto distance = d.r * d.r + d.g * d.g + d.b * d.b;
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	}
+
+	std::memcpy(out, &color0, 2);
+	std::memcpy(out + 2, &color1, 2);
+	std::memcpy(out + 4, &indices, 4);
+}
+
+static void encode_channel(const Block& block, int channel, uint8_t* out) {
+	int min = 255, max = 0;
+	for(const auto& t : block) {
+		min = std::min<int>(min, t[channel]);
+		max = std::max<int>(max, t[channel]);
+	}
+
+	//value0 > value1 selects eight interpolated values, equal endpoints leave every index at 0
+	uint64_t indices = 0;
+	if (max != min) {
+		std::array<int, 8> palette { max, min };
+		for(int i = 1; i < 7; i++) {
+			palette[i + 1] = ((7 - i) * max + i * min) / 7;
+		}
+
+		for(int i = 0; i < 16; i++) {
+			uint64_t best = 0;
+			int bestDistance = INT32_MAX;
+			for(uint64_t p = 0; p < 8; p++) {
+				auto distance = std::abs(block[i][channel] - palette[p]);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (3 * i);
+		}
+	}
+
+	out[0] = static_cast<uint8_t>(max);
+	out[1] = static_cast<uint8_t>(min);
+	std::memcpy(out + 2, &indices, 6);
+}
+
+template<typename F>
+static std::vector<uint8_t> compress(const uint8_t* rgba, glm::ivec2 size, size_t blockBytes, F&& encode) {
+	glm::ivec2 blocks = (size + 3) / 4;
+	std::vector<uint8_t> out(static_cast<size_t>(blocks.x) * blocks.y * blockBytes);
+
+	for(int y = 0; y < blocks.y; y++) {
+		for(int x = 0; x < blocks.x; x++) {
+			encode(read_block(rgba, size, x, y), out.data() + (static_cast<size_t>(y) * blocks.x + x) * blockBytes);
+		}
+	}
+
+	return out;
+}
+
+std::vector<uint8_t> compress_bc1(const uint8_t* rgba, glm::ivec2 size) {
+	return compress(rgba, size, 8, [](const Block& block, uint8_t* out) {
+		encode_color(block, out);
+	});
+}
+
+std::vector<uint8_t> compress_bc3(const uint8_t* rgba, glm::ivec2 size) {
+	return compress(rgba, size, 16, [](const Block& block, uint8_t* out) {
+		encode_channel(block, 3, out);
+		encode_color(block, out + 8);
+	});
+}
+
+std::vector<uint8_t> compress_bc5(const uint8_t* rgba, glm::ivec2 size) {
+	return compress(rgba, size, 16, [](const Block& block, uint8_t* out) {
+		encode_channel(block, 0, out);
+		encode_channel(block, 1, out + 8);
+	});
+}
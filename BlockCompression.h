@@ -0,0 +1,19 @@
+#ifndef VKOCCLUSIONTEST_BLOCKCOMPRESSION_H
+#define VKOCCLUSIONTEST_BLOCKCOMPRESSION_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// CPU encoders for the block compressed formats the texture converter writes. Endpoints are fit to the bounding box of
+// each 4x4 block, which is fast and good enough for material textures, not a high quality encoder.
+// 'rgba' holds 'size' RGBA8 texels, edge blocks repeat the last row and column
+
+// BC1 without alpha, 8 bytes per block
+std::vector<uint8_t> compress_bc1(const uint8_t* rgba, glm::ivec2 size);
+// BC4 alpha followed by BC1 color, 16 bytes per block
+std::vector<uint8_t> compress_bc3(const uint8_t* rgba, glm::ivec2 size);
+// BC4 red followed by BC4 green, 16 bytes per block. For tangent space normal maps
+std::vector<uint8_t> compress_bc5(const uint8_t* rgba, glm::ivec2 size);
+
+#endif //VKOCCLUSIONTEST_BLOCKCOMPRESSION_H
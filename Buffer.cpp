@@ -14,16 +14,26 @@ uint32_t Buffer::findMemoryType(const vk::ArrayProxy<vk::MemoryType> &types, uin
 	throw std::runtime_error("Could not find memory property");
 }
 
-Buffer::Buffer(std::shared_ptr<Instance> _instance, size_t bufferSize, vk::BufferUsageFlags bufferFlags, vk::MemoryPropertyFlags memoryFlags) : instance(std::move(_instance)) {
+Buffer::Buffer(std::shared_ptr<Instance> _instance, size_t bufferSize, vk::BufferUsageFlags bufferFlags, vk::MemoryPropertyFlags memoryFlags) : instance(std::move(_instance)), _address(0), _persistent_mapping(nullptr) {
 	auto device = instance->device();
 
 	_buffer = device.createBuffer({{}, bufferSize, bufferFlags, vk::SharingMode::eExclusive });
 	auto requirements = device.getBufferMemoryRequirements(_buffer);
 	auto idx = findMemoryType(instance->memory_properties().memoryTypes, requirements.memoryTypeBits, memoryFlags);
 
-	bufferMemory = device.allocateMemory({ requirements.size, idx });
+	vk::MemoryAllocateInfo allocateInfo(requirements.size, idx);
+	vk::MemoryAllocateFlagsInfo allocateFlags(vk::MemoryAllocateFlagBits::eDeviceAddress);
+	if (bufferFlags & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
+		allocateInfo.setPNext(&allocateFlags);
+	}
+
+	bufferMemory = device.allocateMemory(allocateInfo);
 	device.bindBufferMemory(_buffer, bufferMemory, 0);
 	this->bufferSize = bufferSize;
+
+	if (bufferFlags & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
+		_address = device.getBufferAddress({ _buffer });
+	}
 }
 
 void Buffer::clean() {
@@ -32,6 +42,10 @@ void Buffer::clean() {
 	}
 
 	auto device = instance->device();
+	if (_persistent_mapping != nullptr) {
+		device.unmapMemory(bufferMemory);
+		_persistent_mapping = nullptr;
+	}
 	device.destroyBuffer(_buffer);
 	device.freeMemory(bufferMemory);
 }
@@ -44,6 +58,14 @@ BufferMapping Buffer::map() const {
 	return {instance->device(), *this};
 }
 
+void* Buffer::persistent_mapping() {
+	if (_persistent_mapping == nullptr) {
+		_persistent_mapping = instance->device().mapMemory(bufferMemory, 0, bufferSize);
+	}
+
+	return _persistent_mapping;
+}
+
 void Buffer::copy_to(const Buffer &other, const vk::CommandBuffer& commandBuffer) {
 	//commandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit, {}});
 	commandBuffer.copyBuffer(_buffer, other._buffer, vk::BufferCopy{0, 0, bufferSize });
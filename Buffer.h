@@ -17,6 +17,8 @@ private:
 	vk::Buffer _buffer;
 	vk::DeviceMemory bufferMemory;
 	size_t bufferSize;
+	vk::DeviceAddress _address;
+	void* _persistent_mapping;
 public:
 	static uint32_t findMemoryType(const vk::ArrayProxy<vk::MemoryType>& types, uint32_t typeFilter, vk::MemoryPropertyFlags properties);
 
@@ -38,8 +40,17 @@ public:
 		return bufferMemory;
 	}
 
+	// Only valid for buffers created with vk::BufferUsageFlagBits::eShaderDeviceAddress
+	inline vk::DeviceAddress device_address() const {
+		return _address;
+	}
+
 	BufferMapping map() const;
 
+	// Maps the whole buffer once and keeps it mapped until the buffer is destroyed.
+	// Do not mix with map()/map_t() on the same buffer.
+	void* persistent_mapping();
+
 	template<typename T>
 	BufferMapping_t<T> map_t() const {
 		return BufferMapping_t<T>(instance->device(), *this);
@@ -2,10 +2,11 @@
 #include "Utils.h"
 #include <stdexcept>
 
-ComputePipeline::ComputePipeline(std::shared_ptr<Instance> inst, const std::filesystem::path &shaderPath,
+ComputePipeline::ComputePipeline(std::shared_ptr<Instance> inst, const vk::PipelineCache& cache, std::span<const uint32_t> shaderCode,
 								 const std::vector<std::vector<vk::DescriptorSetLayoutBinding>> &descriptorBindings,
-								 const std::vector<vk::PushConstantRange>& pushConstants) : instance(std::move(inst)) {
-	auto mod = createShaderModule(shaderPath, instance->device());
+								 const std::vector<vk::PushConstantRange>& pushConstants, const std::vector<uint32_t>& specialization) :
+								 instance(std::move(inst)), _specialization(specialization) {
+	auto mod = createShaderModule(shaderCode, instance->device());
 
 	_modules.push_back(mod);
 
@@ -16,10 +17,16 @@ ComputePipeline::ComputePipeline(std::shared_ptr<Instance> inst, const std::file
 
 	_pipeline_layout = instance->device().createPipelineLayout({{}, _descriptor_layouts, pushConstants });
 
-	vk::PipelineShaderStageCreateInfo shaderStage( {}, vk::ShaderStageFlagBits::eCompute, mod, "main");
+	std::vector<vk::SpecializationMapEntry> entries;
+	for(uint32_t i = 0; i < _specialization.size(); i++) {
+		entries.emplace_back(i, i * sizeof(uint32_t), sizeof(uint32_t));
+	}
+	vk::SpecializationInfo specializationInfo(entries.size(), entries.data(), _specialization.size() * sizeof(uint32_t), _specialization.data());
+
+	vk::PipelineShaderStageCreateInfo shaderStage( {}, vk::ShaderStageFlagBits::eCompute, mod, "main", _specialization.empty() ? nullptr : &specializationInfo);
 
 	vk::ComputePipelineCreateInfo info( {}, shaderStage, _pipeline_layout );
-	auto res = instance->device().createComputePipeline(nullptr, info);
+	auto res = instance->device().createComputePipeline(cache, info);
 	switch(res.result) {
 		case vk::Result::eSuccess:
 			_pipeline = res.value;
@@ -3,7 +3,8 @@
 
 #include <vulkan/vulkan.hpp>
 #include <memory>
-#include <filesystem>
+#include <span>
+#include <glm/glm.hpp>
 #include "Instance.h"
 
 class ComputePipeline {
@@ -13,8 +14,11 @@ private:
 	vk::Pipeline _pipeline;
 	std::vector<vk::DescriptorSetLayout> _descriptor_layouts;
 	vk::PipelineLayout _pipeline_layout;
+	std::vector<uint32_t> _specialization;
 public:
-	ComputePipeline(std::shared_ptr<Instance> inst, const std::filesystem::path& shaderPath, const std::vector<std::vector<vk::DescriptorSetLayoutBinding>>& descriptorBindings, const std::vector<vk::PushConstantRange>& push_constants = {});
+	// 'specialization' holds the values of the shader's specialization constants, constant_id N is specialization[N]
+	ComputePipeline(std::shared_ptr<Instance> inst, const vk::PipelineCache& cache, std::span<const uint32_t> shaderCode, const std::vector<std::vector<vk::DescriptorSetLayoutBinding>>& descriptorBindings, const std::vector<vk::PushConstantRange>& push_constants = {},
+					const std::vector<uint32_t>& specialization = {});
 	~ComputePipeline();
 
 	inline const vk::Pipeline& pipeline() const {
@@ -32,6 +36,21 @@ public:
 	inline const vk::PipelineLayout& pipeline_layout() const {
 		return _pipeline_layout;
 	}
+
+	inline const std::vector<uint32_t>& specialization() const {
+		return _specialization;
+	}
+
+	// By convention specialization constants 0 and 1 are local_size_x and local_size_y
+	inline glm::uvec2 workgroup_size() const {
+		return { _specialization.size() > 0 ? _specialization[0] : 1, _specialization.size() > 1 ? _specialization[1] : 1 };
+	}
+
+	// Workgroups needed to cover 'invocations'
+	inline glm::uvec2 group_count(glm::uvec2 invocations) const {
+		auto size = workgroup_size();
+		return (invocations + size - 1U) / size;
+	}
 };
 
 #endif //VKOCCLUSIONTEST_COMPUTEPIPELINE_H
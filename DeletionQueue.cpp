@@ -0,0 +1,32 @@
+#include "DeletionQueue.h"
+
+DeletionQueue::DeletionQueue() : _frame(0) {
+
+}
+
+DeletionQueue::~DeletionQueue() {
+	flush_all();
+}
+
+void DeletionQueue::push(std::function<void()> destroy) {
+	_entries.push_back({ _frame, std::move(destroy) });
+}
+
+void DeletionQueue::set_frame(uint64_t frame) {
+	_frame = frame;
+}
+
+void DeletionQueue::flush(uint64_t completedFrames) {
+	//Entries are pushed in frame order
+	while(!_entries.empty() && _entries.front().frame < completedFrames) {
+		_entries.front().destroy();
+		_entries.pop_front();
+	}
+}
+
+void DeletionQueue::flush_all() {
+	for(auto& entry : _entries) {
+		entry.destroy();
+	}
+	_entries.clear();
+}
@@ -0,0 +1,41 @@
+#ifndef VKOCCLUSIONTEST_DELETIONQUEUE_H
+#define VKOCCLUSIONTEST_DELETIONQUEUE_H
+
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+// Destroys objects once the GPU is done with every frame submitted before they were retired.
+// Frames are numbered in submission order, and complete in that order on a single queue
+class DeletionQueue {
+private:
+	struct Entry {
+		// Frame whose fence has to be signaled first
+		uint64_t frame;
+		std::function<void()> destroy;
+	};
+
+	std::deque<Entry> _entries;
+	uint64_t _frame;
+public:
+	DeletionQueue();
+
+	DeletionQueue(const DeletionQueue&) = delete;
+	DeletionQueue(DeletionQueue&&) = delete;
+	~DeletionQueue();
+
+	// Retires an object, 'destroy' runs once the next frame to be submitted is done
+	void push(std::function<void()> destroy);
+	// Called after submitting, objects retired from now on wait for frame 'frame'
+	void set_frame(uint64_t frame);
+	// Runs everything retired before 'completedFrames' frames were done
+	void flush(uint64_t completedFrames);
+	// Only once the device is idle
+	void flush_all();
+
+	inline size_t size() const {
+		return _entries.size();
+	}
+};
+
+#endif //VKOCCLUSIONTEST_DELETIONQUEUE_H
@@ -0,0 +1,62 @@
+#include "DynamicBuffer.h"
+#include <algorithm>
+
+DynamicBuffer::DynamicBuffer(std::shared_ptr<Instance> inst, size_t stride, vk::BufferUsageFlags usage, BufferPlacement placement) :
+	instance(std::move(inst)), _usage(usage), _placement(placement), _stride(stride), _capacity(0), _underused_frames(0) {
+
+}
+
+void DynamicBuffer::allocate(size_t capacity) {
+	auto usage = _usage | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+	vk::MemoryPropertyFlags memory = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+	if (_placement == BufferPlacement::eDeviceLocal) {
+		usage |= vk::BufferUsageFlagBits::eTransferDst;
+		memory = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	}
+
+	_buffer = std::make_unique<Buffer>(instance, capacity * _stride, usage, memory);
+	_staging = nullptr;
+	_capacity = capacity;
+	_underused_frames = 0;
+}
+
+bool DynamicBuffer::reserve(size_t count) {
+	if (_buffer == nullptr || count > _capacity) {
+		allocate(std::max({ count, _capacity * 2, (size_t) DYNAMIC_BUFFER_MIN_ELEMENTS }));
+		return true;
+	}
+
+	//Shrink only after a long streak of low usage, so oscillating counts don't reallocate every frame
+	if (_capacity > DYNAMIC_BUFFER_MIN_ELEMENTS && count * 4 < _capacity) {
+		if (++_underused_frames >= DYNAMIC_BUFFER_SHRINK_FRAMES) {
+			allocate(std::max(count * 2, (size_t) DYNAMIC_BUFFER_MIN_ELEMENTS));
+			return true;
+		}
+	} else {
+		_underused_frames = 0;
+	}
+
+	return false;
+}
+
+const std::unique_ptr<Buffer>& DynamicBuffer::upload_target() {
+	if (_placement == BufferPlacement::eHostVisible) {
+		return _buffer;
+	}
+
+	if (_staging == nullptr) {
+		_staging = std::make_unique<Buffer>(instance, _buffer->size(), vk::BufferUsageFlagBits::eTransferSrc,
+											vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	}
+
+	return _staging;
+}
+
+void DynamicBuffer::record_upload(const vk::CommandBuffer& cmd, const vk::ArrayProxy<const vk::BufferCopy>& regions) const {
+	if (_placement == BufferPlacement::eHostVisible || _staging == nullptr || regions.empty()) {
+		return;
+	}
+
+	cmd.copyBuffer(_staging->buffer(), _buffer->buffer(), regions);
+}
@@ -0,0 +1,62 @@
+#ifndef VKOCCLUSIONTEST_DYNAMICBUFFER_H
+#define VKOCCLUSIONTEST_DYNAMICBUFFER_H
+
+#include <vulkan/vulkan.hpp>
+#include <memory>
+#include <vector>
+#include "Instance.h"
+#include "Buffer.h"
+
+#define DYNAMIC_BUFFER_MIN_ELEMENTS 64
+#define DYNAMIC_BUFFER_SHRINK_FRAMES 120
+
+enum class BufferPlacement {
+	// Written directly by the CPU, read by the GPU over the bus
+	eHostVisible,
+	// Kept in VRAM and filled through a staging buffer
+	eDeviceLocal
+};
+
+// Buffer of 'stride' sized elements that grows geometrically and only shrinks after
+// being mostly unused for DYNAMIC_BUFFER_SHRINK_FRAMES consecutive frames
+class DynamicBuffer {
+private:
+	std::shared_ptr<Instance> instance;
+	vk::BufferUsageFlags _usage;
+	BufferPlacement _placement;
+	size_t _stride;
+	size_t _capacity;
+	uint32_t _underused_frames;
+	std::unique_ptr<Buffer> _buffer;
+	std::unique_ptr<Buffer> _staging;
+
+	void allocate(size_t capacity);
+public:
+	DynamicBuffer(std::shared_ptr<Instance> inst, size_t stride, vk::BufferUsageFlags usage, BufferPlacement placement);
+
+	// Makes room for at least 'count' elements, returns true if the buffer was reallocated (losing its contents)
+	bool reserve(size_t count);
+
+	// Buffer the CPU writes into: the buffer itself, or its staging buffer when device local
+	const std::unique_ptr<Buffer>& upload_target();
+	// Copies the given staging regions into the buffer, no-op for host visible buffers
+	void record_upload(const vk::CommandBuffer& cmd, const vk::ArrayProxy<const vk::BufferCopy>& regions) const;
+
+	inline const std::unique_ptr<Buffer>& buffer() const {
+		return _buffer;
+	}
+
+	inline size_t capacity() const {
+		return _capacity;
+	}
+
+	inline BufferPlacement placement() const {
+		return _placement;
+	}
+
+	inline vk::DeviceAddress device_address() const {
+		return _buffer->device_address();
+	}
+};
+
+#endif //VKOCCLUSIONTEST_DYNAMICBUFFER_H
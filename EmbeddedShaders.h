@@ -0,0 +1,17 @@
+#ifndef VKOCCLUSIONTEST_EMBEDDEDSHADERS_H
+#define VKOCCLUSIONTEST_EMBEDDEDSHADERS_H
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// SPIR-V modules compiled and embedded at build time (see cmake/EmbedShaders.cmake)
+struct EmbeddedShader {
+	std::string_view name;
+	std::span<const uint32_t> code;
+};
+
+// Returns the embedded module named 'name' (e.g. "main.vert.spv"), or an empty span if there is none
+std::span<const uint32_t> find_embedded_shader(std::string_view name);
+
+#endif //VKOCCLUSIONTEST_EMBEDDEDSHADERS_H
@@ -2,69 +2,119 @@
 #include <array>
 #include "Buffer.h"
 #include <cmath>
+#include <algorithm>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+
+#define DS_ID_CAMERA_GRAPHICS 0
+#define DS_ID_COPY 1
+#define DS_ID_QUERY 2
+// Only allocated when the frame goes through the present pass
+#define DS_ID_PRESENT 3
+
+static FrameGraphImageDesc draw_color_desc(vk::Format format, glm::ivec2 size) {
+	return { format, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled, size };
+}
+
+static FrameGraphImageDesc draw_depth_desc(glm::ivec2 size) {
+	return { PIPELINE_DEPTH_FORMAT, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment, size };
+}
+
+static FrameGraphImageDesc hzb_depth_desc(glm::ivec2 size) {
+	return { vk::Format::eD32Sfloat, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled, size };
+}
+
+static FrameGraphImageDesc hzb_desc(glm::ivec2 size) {
+	return { vk::Format::eR32Sfloat, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage, size, TEXTURE_LEVELS_AUTO };
+}
 
-#define DS_ID_MESH_AND_CAMERA 0
-#define DS_ID_INSTANCES_ONLY 1
-#define DS_ID_COPY 2
-#define DS_ID_CAMERA_ONLY 3
-#define DS_ID_INSTANCES_AND_INDIRECTIONS_COMPUTE 4
-#define DS_ID_QUERY 5
-#define DS_ID_INSTANCES_AND_INDIRECTIONS_GRAPHICS 6
-#define DS_ID_MATERIALS_AND_TEXTURES_0 7
-#define DS_ID_MATERIALS_AND_TEXTURES_1 8
-#define DS_ID_MATERIALS_AND_TEXTURES_2 9
-
-FrameData::FrameData(std::shared_ptr<Instance> inst, int index, const Swapchain& swapchain, glm::ivec2 hzbSize,
-					 PipelineCollection& pipelines, const vk::Sampler& downsampleSampler) :
-					 instance(std::move(inst)), _index(index),
-					 _hzBuffer(instance, hzbSize, pipelines.downsample_pass()->descriptor_set_layouts()[0], downsampleSampler),
-					 _descriptors_up_to_date(false) {
+FrameData::FrameData(std::shared_ptr<Instance> inst, int index, const Swapchain& swapchain, PipelineCollection& pipelines, const vk::Sampler& downsampleSampler, const FrameSettings& settings,
+					 std::shared_ptr<VisibilityCache> visibility) :
+					 instance(std::move(inst)), _index(index), _graph(instance), _record_milliseconds(0.0), _settings(settings),
+					 _instanceBuffer(instance, sizeof(ObjectInstance), vk::BufferUsageFlagBits::eStorageBuffer, settings.sceneBufferPlacement),
+					 _batchesBuffer(instance, sizeof(DrawBatch), vk::BufferUsageFlagBits::eStorageBuffer, settings.sceneBufferPlacement),
+					 _drawBuffer(instance, sizeof(VkDrawIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, BufferPlacement::eDeviceLocal),
+					 _clearBuffer(instance, sizeof(VkDrawIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, BufferPlacement::eDeviceLocal),
+					 _indirectBuffer(instance, sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer, BufferPlacement::eDeviceLocal),
+					 _visibleInstancesBuffer(instance, sizeof(VisibleInstance), vk::BufferUsageFlagBits::eStorageBuffer, BufferPlacement::eDeviceLocal),
+					 _visibleBuffer(instance, sizeof(VkDrawIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, BufferPlacement::eDeviceLocal),
+					 _bvhNodeBuffer(instance, sizeof(BVHNode), vk::BufferUsageFlagBits::eStorageBuffer, settings.sceneBufferPlacement),
+					 _bvhLeafBuffer(instance, sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer, settings.sceneBufferPlacement),
+					 _bvhQueueBuffer(instance, sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer, BufferPlacement::eDeviceLocal),
+					 _candidateBuffer(instance, sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, BufferPlacement::eDeviceLocal),
+					 _bvh_nodes(0), _bvh_levels(0),
+					 _visibility(std::move(visibility)), _visibility_frame(0), _layout_version(0),
+					 _uploaded_version(0), _uploaded_bytes(0), _queried_objects(0), _downsample_sampler(downsampleSampler) {
 
 	_command_buffer = instance->device().allocateCommandBuffers({ instance->graphics_command_pool(), vk::CommandBufferLevel::ePrimary, 1})[0];
+	for(auto& pass : _passes) {
+		pass.pool = instance->device().createCommandPool({ vk::CommandPoolCreateFlagBits::eTransient, instance->graphics_queue_index() });
+		pass.buffer = instance->device().allocateCommandBuffers({ pass.pool, vk::CommandBufferLevel::eSecondary, 1 })[0];
+	}
 	_in_flight_fence = instance->device().createFence({ vk::FenceCreateFlagBits::eSignaled });
-	_render_in_progress_semaphore = instance->device().createSemaphore({});
 	_cameraBuffer = std::make_unique<Buffer>(instance, sizeof(UniformData), vk::BufferUsageFlagBits::eUniformBuffer,
 											 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	_settings.secondaryViews = std::min(_settings.secondaryViews, FRAME_MAX_VIEWS - 1U);
+	_viewBuffer = std::make_unique<Buffer>(instance, FRAME_MAX_VIEWS * sizeof(ViewData), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+										   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	_bvhListBuffer = std::make_unique<Buffer>(instance, BVH_MAX_LEVELS * sizeof(DispatchList),
+											  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst |
+											  vk::BufferUsageFlagBits::eShaderDeviceAddress, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	_countBuffer = std::make_unique<Buffer>(instance, (DRAW_COUNT_BVH_NODES + 1) * sizeof(uint32_t),
+											vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst |
+											vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+											vk::MemoryPropertyFlagBits::eDeviceLocal);
+	_readbackBuffer = std::make_unique<Buffer>(instance, (READBACK_CANDIDATES + 1) * sizeof(uint32_t), vk::BufferUsageFlagBits::eTransferDst,
+											   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	std::memset(_readbackBuffer->persistent_mapping(), 0, (READBACK_CANDIDATES + 1) * sizeof(uint32_t));
 
-	vk::FramebufferCreateInfo zFBInfo( {}, pipelines.z_pass()->render_pass(), 1, &_hzBuffer.depth_view(), _hzBuffer.depth_texture().size().x, _hzBuffer.depth_texture().size().y, 1);
-	_z_framebuffer = instance->device().createFramebuffer(zFBInfo);
+	declare_resources(pipelines.color_format(), swapchain.size());
 
+	//Storage buffers are passed to the shaders by device address, so only these sets are left.
+	//None of them reference scene buffers, they are only written again when the graph recreates its images
 	std::vector<vk::DescriptorSetLayout> layouts {
 		pipelines.z_pass()->descriptor_set_layouts()[0],
-		pipelines.z_pass()->descriptor_set_layouts()[1],
 		pipelines.copy_pass()->descriptor_set_layouts()[0],
 		pipelines.query_pass()->descriptor_set_layouts()[0],
-		pipelines.query_pass()->descriptor_set_layouts()[1],
-		pipelines.query_pass()->descriptor_set_layouts()[2],
-		pipelines.draw_pass()->descriptor_set_layouts()[1],
-		pipelines.draw_pass()->descriptor_set_layouts()[2],
-		pipelines.draw_pass()->descriptor_set_layouts()[2],
-		pipelines.draw_pass()->descriptor_set_layouts()[2],
 	};
+	if (!_settings.directPresent) {
+		layouts.push_back(pipelines.present_pass()->descriptor_set_layouts()[0]);
+	}
 
 	descriptorSets = instance->create_descriptor_sets(layouts);
 
-	nearestSampler = std::make_unique<Sampler>(instance, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest);
+	//The query picks HZB levels with textureLod through either of these, they must not be clamped to level 0
+	nearestSampler = std::make_unique<Sampler>(instance, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest,
+											   vk::SamplerReductionMode::eWeightedAverage, VK_LOD_CLAMP_NONE);
 	linearSampler = std::make_unique<Sampler>(instance, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear);
-	whiteTexture = std::make_unique<Texture>(instance, PIPELINE_COLOR_FORMAT, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, glm::ivec2(2, 2), 1);
+	if (pipelines.hzb_reduction()) {
+		maxSampler = std::make_unique<Sampler>(instance, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest, vk::SamplerReductionMode::eMax,
+											   VK_LOD_CLAMP_NONE);
+	}
 
+	if (instance->timestamps_supported()) {
+		_timer = std::make_unique<GpuTimer>(instance, FRAME_TIMER_REGIONS);
+	}
 }
 
 FrameData::~FrameData() {
 	if (_in_flight_fence) {
 		instance->device().destroyFence(_in_flight_fence);
 	}
-	if (_render_in_progress_semaphore) {
-		instance->device().destroySemaphore(_render_in_progress_semaphore);
-	}
-	if (_z_framebuffer) {
-		instance->device().destroyFramebuffer(_z_framebuffer);
-	}
 
-	if (_draw_frame_buffer) {
-		instance->device().destroyFramebuffer(_draw_frame_buffer);
+	for(auto& pass : _passes) {
+		if (pass.pool) {
+			instance->device().destroyCommandPool(pass.pool);
+		}
 	}
 
+	destroy_graph_views();
+}
+
+void FrameData::destroy_graph_views() {
 	if (_draw_color_view) {
 		instance->device().destroyImageView(_draw_color_view);
 	}
@@ -72,325 +122,647 @@ FrameData::~FrameData() {
 	if (_draw_depth_view) {
 		instance->device().destroyImageView(_draw_depth_view);
 	}
+
+	_draw_color_view = nullptr;
+	_draw_depth_view = nullptr;
+	_hzBuffer = nullptr;
+}
+
+void FrameData::declare_resources(vk::Format colorFormat, glm::ivec2 drawSize) {
+	//Only the HZB and the draw targets live within a frame: the HZB is done before drawing starts, so they can share memory.
+	//The color target is never used, and so never created, when drawing into the swapchain image directly
+	auto hzbSize = _settings.hzb.size_for(drawSize);
+	_resources.hzbDepth = _graph.create_image("hzb depth", hzb_depth_desc(hzbSize), vk::ImageAspectFlagBits::eDepth);
+	_resources.hzb = _graph.create_image("hzb", hzb_desc(hzbSize), vk::ImageAspectFlagBits::eColor);
+	_resources.drawColor = _graph.create_image("draw color", draw_color_desc(colorFormat, drawSize), vk::ImageAspectFlagBits::eColor);
+	_resources.drawDepth = _graph.create_image("draw depth", draw_depth_desc(drawSize), vk::ImageAspectFlagBits::eDepth);
+	_resources.swapchain = _graph.import_image("swapchain", vk::ImageAspectFlagBits::eColor, vk::ImageLayout::ePresentSrcKHR);
+
+	_resources.scene = _graph.import_buffer("scene");
+	_resources.counts = _graph.import_buffer("counts");
+	_resources.drawCommands = _graph.import_buffer("draw commands");
+	_resources.viewCommands = _graph.import_buffer("view commands");
+	_resources.visible = _graph.import_buffer("visible");
+	_resources.compacted = _graph.import_buffer("compacted");
+	_resources.readback = _graph.import_buffer("readback");
+	//Written by the query pass of the frame before, which may be another slot's
+	_resources.history = _graph.import_buffer("visibility history", vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite);
+	_resources.traversal = _graph.import_buffer("bvh traversal");
 }
 
-void FrameData::draw(const vk::CommandBuffer& cmd, Scene &s, const UniformData& camera, PipelineCollection& pipelines,
-					 const vk::Image& swapchainImg, glm::ivec2 finalSize) {
+void FrameData::on_graph_resources_changed(PipelineCollection& pipelines) {
+	//The slot's fence was waited on, nothing of its last submission still uses the old views
+	destroy_graph_views();
+
+	const auto& hzb = _graph.texture(_resources.hzb);
+	const auto& hzbDepth = _graph.texture(_resources.hzbDepth);
+	_hzBuffer = std::make_unique<HZBuffer>(instance, hzb, hzbDepth, pipelines.downsample_pass()->descriptor_set_layouts()[0],
+										   maxSampler ? maxSampler->sampler() : _downsample_sampler, maxSampler != nullptr);
+
+	const auto& drawDepth = _graph.texture(_resources.drawDepth);
+
+	vk::ComponentMapping mapping = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA };
+	if (!_settings.directPresent) {
+		const auto& drawColor = _graph.texture(_resources.drawColor);
+		_draw_color_view = instance->device().createImageView(vk::ImageViewCreateInfo({}, drawColor.image(), vk::ImageViewType::e2D, drawColor.format(), mapping,
+																					  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+	}
+
+	_draw_depth_view = instance->device().createImageView(vk::ImageViewCreateInfo({}, drawDepth.image(), vk::ImageViewType::e2D, PIPELINE_DEPTH_FORMAT, mapping,
+																				  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1)));
+
+	update_descriptor_sets();
+
+	std::cout << "[FrameGraph] slot " << _index << ": " << _graph.culled_passes() << " passes culled, transient images "
+			  << (_graph.transient_bytes() / (1024.0 * 1024.0)) << " MiB aliased into " << (_graph.allocated_bytes() / (1024.0 * 1024.0)) << " MiB, HZB "
+			  << hzb.size().x << "x" << hzb.size().y << std::endl;
+}
+
+void FrameData::latch_camera(const UniformData& camera, const std::vector<ViewData>& secondaryViews) {
+	if (secondaryViews.size() != _settings.secondaryViews) {
+		throw std::runtime_error("Expected " + std::to_string(_settings.secondaryViews) + " secondary views, got " + std::to_string(secondaryViews.size()));
+	}
+
+	//The camera and view buffers are host coherent and only read once the command buffer executes,
+	//so they can be written after recording, right before submission
+	*static_cast<UniformData*>(_cameraBuffer->persistent_mapping()) = camera;
 
-	if (_draw_color == nullptr || _draw_depth == nullptr || _draw_color->size() != finalSize) {
-		update_draw_fb(pipelines, finalSize);
+	auto views = static_cast<ViewData*>(_viewBuffer->persistent_mapping());
+	auto mainFlags = VIEW_FLAG_OCCLUSION;
+	if (_visibility) {
+		mainFlags |= _visibility->latch(camera.view, camera.projection, _layout_version);
+	}
+	views[0] = makeView(camera.view, camera.projection, mainFlags);
+	if (_visibility) {
+		views[0].historyEpoch = _visibility->epoch();
+		views[0].resetEpoch = _visibility->reset_epoch();
 	}
+	std::copy(secondaryViews.begin(), secondaryViews.end(), views + 1);
+}
+
+void FrameData::draw(const vk::CommandBuffer& cmd, Scene &s, PipelineCollection& pipelines,
+					 const vk::Image& swapchainImg, const vk::ImageView& swapchainView, glm::ivec2 finalSize, ThreadPool* recordPool) {
+	auto recordStart = std::chrono::steady_clock::now();
 
-	{
-		auto map = _cameraBuffer->map_t<UniformData>();
-		static_cast<UniformData*>(map)[0] = camera;
+	if (_timer) {
+		report_tuning(pipelines);
+		_timer->reset(cmd);
 	}
+	_tuned_shapes.clear();
+	_queried_objects = 0;
+	_uploaded_bytes = 0;
 
 	if (s.batches_amount() == 0 || s.objects().size() == 0) {
-		vk::ImageMemoryBarrier presentBarrier(vk::AccessFlagBits::eNone,
-											  vk::AccessFlagBits::eNone,
-											  vk::ImageLayout::eUndefined,
-											  vk::ImageLayout::ePresentSrcKHR,
-											  VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-											  swapchainImg,
-											  {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
-
-		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands, {}, nullptr, nullptr, presentBarrier);
+		//Only hands the image to presentation, after the transfer stages the acquire semaphore is waited on
+		vk::ImageMemoryBarrier2 presentBarrier(vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eNone,
+											   vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+											   vk::ImageLayout::eUndefined,
+											   vk::ImageLayout::ePresentSrcKHR,
+											   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+											   swapchainImg,
+											   {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+
+		cmd.pipelineBarrier2(vk::DependencyInfo({}, nullptr, nullptr, presentBarrier));
+		_record_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
 		return;
 	}
 
-	if (_instanceBuffer == nullptr || _instanceBuffer->size() / sizeof(ObjectInstance) < s.objects().size()) {
-		_instanceBuffer = std::make_unique<Buffer>(instance, s.objects().size() * sizeof(ObjectInstance), vk::BufferUsageFlagBits::eStorageBuffer,
-												   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-		_descriptors_up_to_date = false;
+	//The slot's fence was waited on, so buffers last used by this slot can be replaced.
+	//A replaced buffer lost its contents and needs a full upload
+	bool reallocated = _instanceBuffer.reserve(s.objects().size());
+	reallocated = _batchesBuffer.reserve(s.batches_amount()) || reallocated;
+	bool hierarchy = _settings.hierarchicalCulling;
+	if (hierarchy) {
+		//The hierarchy is only rebuilt on refresh, its size is known after it
+		s.refresh_instances();
+		reallocated = _bvhNodeBuffer.reserve(s.bvh().nodes().size()) || reallocated;
+		reallocated = _bvhLeafBuffer.reserve(s.objects().size()) || reallocated;
+		_bvhQueueBuffer.reserve(s.bvh().nodes().size());
+		_candidateBuffer.reserve(sizeof(DispatchList) / sizeof(uint32_t) + s.objects().size());
+		_bvh_nodes = static_cast<uint32_t>(s.bvh().nodes().size());
+		_bvh_levels = static_cast<uint32_t>(s.bvh().levels().size());
 	}
+	_drawBuffer.reserve(s.batches_amount());
+	_clearBuffer.reserve(s.batches_amount() * views_amount());
+	//History entries are indexed by instance slot
+	if (_visibility && s.objects().size() > _visibility->capacity()) {
+		throw std::runtime_error("Scene has more instances than the visibility history holds!");
+	}
+	_visibility_frame = _visibility ? _visibility->next_frame() : 0;
+	_layout_version = s.layout_version();
 
-	if (_batchesBuffer == nullptr || _batchesBuffer->size() / sizeof(DrawBatch) < s.batches_amount()) {
-		_batchesBuffer = std::make_unique<Buffer>(instance, s.batches_amount() * sizeof(DrawBatch), vk::BufferUsageFlagBits::eStorageBuffer,
-												  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-		_descriptors_up_to_date = false;
+	_indirectBuffer.reserve(s.objects().size() * views_amount());
+	_visibleInstancesBuffer.reserve(s.objects().size());
+	if (_settings.compactDraws) {
+		_visibleBuffer.reserve(s.batches_amount() * views_amount());
 	}
 
-	if (_drawBuffer == nullptr || _drawBuffer->size() / sizeof(VkDrawIndirectCommand) < s.batches_amount()) {
-		_drawBuffer = std::make_unique<Buffer>(instance, s.batches_amount() * sizeof(VkDrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
-												  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-		_descriptors_up_to_date = false;
+	if (reallocated) {
+		_uploaded_version = 0;
 	}
 
-	if (_clearBuffer == nullptr || _clearBuffer->size() / sizeof(VkDrawIndirectCommand) < s.batches_amount()) {
-		_clearBuffer = std::make_unique<Buffer>(instance, s.batches_amount() * sizeof(VkDrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
-											   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-		_descriptors_up_to_date = false;
-	}
-
-	if (_indirectBuffer == nullptr || _indirectBuffer->size() / sizeof(uint32_t) < s.objects().size()) {
-		_indirectBuffer = std::make_unique<Buffer>(instance, s.objects().size() * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer,
-												   vk::MemoryPropertyFlagBits::eDeviceLocal);
-		_descriptors_up_to_date = false;
-	}
-
-	s.fill_buffers(_instanceBuffer, _batchesBuffer, _drawBuffer, _clearBuffer);
-
-	if (!_descriptors_up_to_date) {
-		update_descriptor_sets(*s.meshes());
-	}
-
-	run_z_pass(cmd, pipelines, s.batches_amount());
-
-	vk::ImageMemoryBarrier copyRedBarrier(vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-										  vk::AccessFlagBits::eShaderRead,
-										  vk::ImageLayout::eTransferSrcOptimal,
-										  vk::ImageLayout::eShaderReadOnlyOptimal,
-										  VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-										  _hzBuffer.depth_texture().image(),
-										  {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1});
-	vk::ImageMemoryBarrier copyWriteBarrier(vk::AccessFlagBits::eNone,
-											vk::AccessFlagBits::eShaderWrite|vk::AccessFlagBits::eShaderRead,
-											vk::ImageLayout::eUndefined,
-											vk::ImageLayout::eGeneral,
-											VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-											_hzBuffer.texture().image(),
-											{vk::ImageAspectFlagBits::eColor, 0, _hzBuffer.texture().levels(), 0, 1});
-
-	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests, vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, {{ copyRedBarrier, copyWriteBarrier }});
-
-	run_copy_pass(cmd, pipelines);
-
-	run_downsample(cmd, pipelines);
-
-	vk::ImageMemoryBarrier afterDownsampleBarrier(vk::AccessFlagBits::eShaderWrite,
-												  vk::AccessFlagBits::eShaderRead,
-												  vk::ImageLayout::eGeneral,
-												  vk::ImageLayout::eShaderReadOnlyOptimal,
-												  VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-												  _hzBuffer.texture().image(),
-												  {vk::ImageAspectFlagBits::eColor, 0, _hzBuffer.texture().levels(), 0, 1});
-
-	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, afterDownsampleBarrier);
-
-	run_query(cmd, pipelines, s.objects().size());
-
-	std::array<vk::ImageMemoryBarrier, 2> drawBarriers {
-			vk::ImageMemoryBarrier(vk::AccessFlagBits::eNone,
-								   vk::AccessFlagBits::eColorAttachmentWrite,
-								   vk::ImageLayout::eUndefined,
-								   vk::ImageLayout::eColorAttachmentOptimal,
-								   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-								   _draw_color->image(),
-								   {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}),
-			vk::ImageMemoryBarrier(vk::AccessFlagBits::eNone,
-								   vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead,
-								   vk::ImageLayout::eUndefined,
-								   vk::ImageLayout::eDepthStencilAttachmentOptimal,
-								   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-								   _draw_depth->image(),
-								   {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1})
+	//Only what changed since this slot was last recorded is written, other slots keep their own version
+	const std::unique_ptr<Buffer> noBuffer;
+	auto upload = s.fill_buffers(_instanceBuffer.upload_target(), _batchesBuffer.upload_target(), hierarchy ? _bvhNodeBuffer.upload_target() : noBuffer,
+								 hierarchy ? _bvhLeafBuffer.upload_target() : noBuffer, _uploaded_version);
+	_uploaded_version = s.version();
+	_uploaded_bytes = upload.bytes;
+
+	//Pipelines are resolved here: the tuner is only touched from this thread, and every pass of the frame sees the same shapes
+	const auto& commandsPipeline = *pipelines.commands_pass();
+	const auto& zPassPipeline = *pipelines.z_pass();
+	const auto& copyPipeline = *pipelines.copy_pass();
+	const auto& downsamplePipeline = *pipelines.downsample_pass();
+	const auto& queryPipeline = *pipelines.query_pass();
+	const auto* bvhPipeline = hierarchy ? pipelines.bvh_pass().get() : nullptr;
+	const auto& compactPipeline = *pipelines.compact_pass();
+	const auto& drawPipeline = *pipelines.draw_pass();
+	const auto* presentPipeline = _settings.directPresent ? nullptr : pipelines.present_pass().get();
+	const auto& meshes = *s.meshes();
+	int batchesAmount = s.batches_amount();
+	int objectsAmount = s.objects().size();
+	bool deviceLocalScene = _settings.sceneBufferPlacement == BufferPlacement::eDeviceLocal;
+
+	using Stage = vk::PipelineStageFlagBits2;
+	using Access = vk::AccessFlagBits2;
+	using Layout = vk::ImageLayout;
+	const auto& r = _resources;
+
+	//Passes declare what they touch and the graph places the barriers between them.
+	//They only stitch the secondary buffers recorded below into the primary one
+	auto execute = [this](uint32_t pass) {
+		return [this, pass](const vk::CommandBuffer& buffer) {
+			buffer.executeCommands(_passes[pass].buffer);
+		};
 	};
 
-	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests, {},
-						vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead), nullptr, drawBarriers);
-
-	draw_final(cmd, pipelines, s.batches_amount(), finalSize);
-
-	std::array<vk::ImageMemoryBarrier, 2> blitBarriers {
-		vk::ImageMemoryBarrier(vk::AccessFlagBits::eColorAttachmentWrite,
-							   vk::AccessFlagBits::eTransferRead,
-							   vk::ImageLayout::eColorAttachmentOptimal,
-							   vk::ImageLayout::eTransferSrcOptimal,
-							   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-							   _draw_color->image(),
-							   {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}),
-		vk::ImageMemoryBarrier(vk::AccessFlagBits::eNone,
-							   vk::AccessFlagBits::eTransferWrite,
-							   vk::ImageLayout::eUndefined,
-							   vk::ImageLayout::eTransferDstOptimal,
-							   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-							   swapchainImg,
-							   {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1})
+	_graph.set_desc(r.drawColor, draw_color_desc(pipelines.color_format(), finalSize));
+	_graph.set_desc(r.drawDepth, draw_depth_desc(finalSize));
+	//Follows the render size, the graph only recreates the pyramid when the policy picks a different one
+	auto hzbSize = _settings.hzb.size_for(finalSize);
+	_graph.set_desc(r.hzbDepth, hzb_depth_desc(hzbSize));
+	_graph.set_desc(r.hzb, hzb_desc(hzbSize));
+	_graph.set_image(r.swapchain, swapchainImg);
+
+	std::vector<FrameGraphAccess> uploadAccesses { { r.counts, Stage::eClear, Access::eTransferWrite } };
+	if (deviceLocalScene) {
+		uploadAccesses.push_back({ r.scene, Stage::eCopy, Access::eTransferWrite });
+	}
+	if (hierarchy) {
+		uploadAccesses.push_back({ r.traversal, Stage::eClear, Access::eTransferWrite });
+	}
+	bool clearHistory = _visibility && _visibility->take_clear();
+	if (clearHistory) {
+		uploadAccesses.push_back({ r.history, Stage::eClear, Access::eTransferWrite });
+	}
+	_graph.add_pass("upload", std::move(uploadAccesses), [&](const vk::CommandBuffer& buffer) {
+		buffer.fillBuffer(_countBuffer->buffer(), 0, VK_WHOLE_SIZE, 0);
+		if (clearHistory) {
+			buffer.fillBuffer(_visibility->history()->buffer(), 0, VK_WHOLE_SIZE, 0);
+		}
+		if (deviceLocalScene) {
+			upload_scene_buffers(buffer, upload, batchesAmount, objectsAmount);
+		}
+
+		if (hierarchy) {
+			//Only the first level is queued, the root. Lists are dispatched with a Y and Z of one once they grow
+			std::array<DispatchList, BVH_MAX_LEVELS> lists;
+			lists.fill({ 0, 1, 1, 0 });
+			lists[0] = { 1, 1, 1, 1 };
+			DispatchList candidates { 0, 1, 1, 0 };
+
+			buffer.updateBuffer(_bvhListBuffer->buffer(), 0, sizeof(lists), lists.data());
+			buffer.updateBuffer(_candidateBuffer.buffer()->buffer(), 0, sizeof(DispatchList), &candidates);
+			buffer.fillBuffer(_bvhQueueBuffer.buffer()->buffer(), 0, sizeof(uint32_t), 0);
+		}
+	});
+
+	_graph.add_pass("commands", {
+		{ r.scene, Stage::eComputeShader, Access::eShaderStorageRead },
+		{ r.counts, Stage::eComputeShader, Access::eShaderStorageRead | Access::eShaderStorageWrite },
+		{ r.drawCommands, Stage::eComputeShader, Access::eShaderStorageWrite },
+		{ r.viewCommands, Stage::eComputeShader, Access::eShaderStorageWrite },
+	}, execute(FRAME_PASS_COMMANDS));
+
+	auto clearDepth = vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0));
+	_graph.add_pass("z pass", {
+		{ r.scene, Stage::eVertexShader, Access::eShaderStorageRead },
+		{ r.drawCommands, Stage::eDrawIndirect, Access::eIndirectCommandRead },
+		{ r.counts, Stage::eDrawIndirect, Access::eIndirectCommandRead },
+		{ r.hzbDepth, Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite,
+		  Layout::eDepthStencilAttachmentOptimal, true },
+	}, [&](const vk::CommandBuffer& buffer) {
+		vk::RenderingAttachmentInfo depth(_hzBuffer->depth_view(), vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ResolveModeFlagBits::eNone, nullptr,
+										  vk::ImageLayout::eUndefined, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, clearDepth);
+		buffer.beginRendering(vk::RenderingInfo(vk::RenderingFlagBits::eContentsSecondaryCommandBuffers, {{ 0, 0 }, {(uint32_t)hzbSize.x, (uint32_t)hzbSize.y}},
+												1, 0, nullptr, &depth));
+		buffer.executeCommands(_passes[FRAME_PASS_Z].buffer);
+		buffer.endRendering();
+	});
+
+	_graph.add_pass(TUNED_KERNEL_COPY, {
+		{ r.hzbDepth, Stage::eComputeShader, Access::eShaderSampledRead, Layout::eShaderReadOnlyOptimal },
+		{ r.hzb, Stage::eComputeShader, Access::eShaderStorageWrite, Layout::eGeneral, true },
+	}, execute(FRAME_PASS_COPY));
+
+	auto downsampleRead = maxSampler ? Access::eShaderSampledRead : Access::eShaderStorageRead;
+	_graph.add_pass(TUNED_KERNEL_DOWNSAMPLE, {
+		{ r.hzb, Stage::eComputeShader, downsampleRead | Access::eShaderStorageWrite, Layout::eGeneral },
+	}, execute(FRAME_PASS_DOWNSAMPLE));
+
+	if (hierarchy) {
+		_graph.add_pass("bvh", {
+			{ r.scene, Stage::eComputeShader, Access::eShaderStorageRead },
+			{ r.counts, Stage::eComputeShader, Access::eShaderStorageRead | Access::eShaderStorageWrite },
+			{ r.hzb, Stage::eComputeShader, Access::eShaderSampledRead, Layout::eShaderReadOnlyOptimal },
+			{ r.traversal, Stage::eDrawIndirect | Stage::eComputeShader, Access::eIndirectCommandRead | Access::eShaderStorageRead | Access::eShaderStorageWrite },
+		}, execute(FRAME_PASS_BVH));
+	}
+
+	std::vector<FrameGraphAccess> queryAccesses {
+		{ r.scene, Stage::eComputeShader, Access::eShaderStorageRead },
+		{ r.counts, Stage::eComputeShader, Access::eShaderStorageRead | Access::eShaderStorageWrite },
+		{ r.hzb, Stage::eComputeShader, Access::eShaderSampledRead, Layout::eShaderReadOnlyOptimal },
+		{ r.viewCommands, Stage::eComputeShader, Access::eShaderStorageRead | Access::eShaderStorageWrite },
+		{ r.visible, Stage::eComputeShader, Access::eShaderStorageWrite },
 	};
+	if (_visibility) {
+		queryAccesses.push_back({ r.history, Stage::eComputeShader, Access::eShaderStorageRead | Access::eShaderStorageWrite });
+	}
+	if (hierarchy) {
+		queryAccesses.push_back({ r.traversal, Stage::eDrawIndirect | Stage::eComputeShader, Access::eIndirectCommandRead | Access::eShaderStorageRead });
+	}
+	_graph.add_pass(TUNED_KERNEL_QUERY, std::move(queryAccesses), execute(FRAME_PASS_QUERY));
+
+	if (_settings.compactDraws) {
+		_graph.add_pass("compact", {
+			{ r.viewCommands, Stage::eComputeShader, Access::eShaderStorageRead },
+			{ r.counts, Stage::eComputeShader, Access::eShaderStorageRead | Access::eShaderStorageWrite },
+			{ r.compacted, Stage::eComputeShader, Access::eShaderStorageWrite },
+		}, execute(FRAME_PASS_COMPACT));
+	}
 
-	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer, {},
-						vk::MemoryBarrier(vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eTransferRead), nullptr, blitBarriers);
+	//Without post processing the frame is drawn into the swapchain image, saving a full-screen read and write of the color target
+	auto drawTarget = _settings.directPresent ? r.swapchain : r.drawColor;
+	auto drawTargetView = _settings.directPresent ? swapchainView : _draw_color_view;
 
-	std::array<vk::ImageBlit, 1> blit {
-		vk::ImageBlit(
-				vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
-				{{ { 0, 0, 0}, {finalSize.x, finalSize.y, 1} }},
-				vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
-				{{ {0, 0, 0}, {finalSize.x, finalSize.y, 1} }}
-				)
+	auto clearColor = vk::ClearValue(vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f));
+	_graph.add_pass("draw", {
+		{ r.visible, Stage::eVertexShader, Access::eShaderStorageRead },
+		{ _settings.compactDraws ? r.compacted : r.viewCommands, Stage::eDrawIndirect, Access::eIndirectCommandRead },
+		{ r.counts, Stage::eDrawIndirect, Access::eIndirectCommandRead },
+		{ drawTarget, Stage::eColorAttachmentOutput, Access::eColorAttachmentWrite, Layout::eColorAttachmentOptimal, true },
+		{ r.drawDepth, Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite,
+		  Layout::eDepthStencilAttachmentOptimal, true },
+	}, [&](const vk::CommandBuffer& buffer) {
+		//Depth is not read after the pass, so it never has to be written back to memory
+		vk::RenderingAttachmentInfo color(drawTargetView, vk::ImageLayout::eColorAttachmentOptimal, vk::ResolveModeFlagBits::eNone, nullptr,
+										  vk::ImageLayout::eUndefined, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, clearColor);
+		vk::RenderingAttachmentInfo depth(_draw_depth_view, vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ResolveModeFlagBits::eNone, nullptr,
+										  vk::ImageLayout::eUndefined, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare, clearDepth);
+		buffer.beginRendering(vk::RenderingInfo(vk::RenderingFlagBits::eContentsSecondaryCommandBuffers, {{ 0, 0 }, {(uint32_t)finalSize.x, (uint32_t)finalSize.y}},
+												1, 0, color, &depth));
+		buffer.executeCommands(_passes[FRAME_PASS_DRAW].buffer);
+		buffer.endRendering();
+	});
+
+	if (!_settings.directPresent) {
+		//A single draw, recorded straight into the primary buffer
+		_graph.add_pass("present", {
+			{ r.drawColor, Stage::eFragmentShader, Access::eShaderSampledRead, Layout::eShaderReadOnlyOptimal },
+			{ r.swapchain, Stage::eColorAttachmentOutput, Access::eColorAttachmentWrite, Layout::eColorAttachmentOptimal, true },
+		}, [&](const vk::CommandBuffer& buffer) {
+			run_present(buffer, *presentPipeline, swapchainView, finalSize);
+		});
+	}
+
+	std::vector<FrameGraphAccess> readbackAccesses {
+		{ r.counts, Stage::eCopy, Access::eTransferRead },
+		{ r.readback, Stage::eCopy, Access::eTransferWrite },
 	};
-	cmd.blitImage(_draw_color->image(), vk::ImageLayout::eTransferSrcOptimal, swapchainImg, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eNearest);
+	if (hierarchy) {
+		readbackAccesses.push_back({ r.traversal, Stage::eCopy, Access::eTransferRead });
+	}
+	_graph.add_pass("readback", std::move(readbackAccesses), [&](const vk::CommandBuffer& buffer) {
+		buffer.copyBuffer(_countBuffer->buffer(), _readbackBuffer->buffer(),
+						  vk::BufferCopy(DRAW_COUNT_VISIBLE * sizeof(uint32_t), 0, READBACK_CANDIDATES * sizeof(uint32_t)));
+		if (hierarchy) {
+			buffer.copyBuffer(_candidateBuffer.buffer()->buffer(), _readbackBuffer->buffer(),
+							  vk::BufferCopy(offsetof(DispatchList, count), READBACK_CANDIDATES * sizeof(uint32_t), sizeof(uint32_t)));
+		}
+
+		vk::MemoryBarrier2 hostBarrier(Stage::eCopy, Access::eTransferWrite, Stage::eHost, Access::eHostRead);
+		buffer.pipelineBarrier2(vk::DependencyInfo({}, hostBarrier, nullptr, nullptr));
+	}, true);
+
+	//Transient images are only replaced when their size changes, the secondary buffers below use their HZB sets
+	if (_graph.compile()) {
+		on_graph_resources_changed(pipelines);
+	}
+
+	//Each pass goes into its own secondary command buffer, recorded in parallel when there is a pool.
+	//Barriers, timestamps and rendering instances stay in the primary buffer, which the graph stitches together below
+	std::vector<std::future<void>> recordJobs;
+	record_pass(FRAME_PASS_COMMANDS, recordPool, recordJobs, nullptr, [&](const vk::CommandBuffer& pass) {
+		run_commands(pass, commandsPipeline, meshes, batchesAmount, objectsAmount);
+	});
+	record_pass(FRAME_PASS_Z, recordPool, recordJobs, &zPassPipeline, [&](const vk::CommandBuffer& pass) {
+		run_z_pass(pass, zPassPipeline, meshes, batchesAmount);
+	});
+	record_pass(FRAME_PASS_COPY, recordPool, recordJobs, nullptr, [&](const vk::CommandBuffer& pass) {
+		run_copy_pass(pass, copyPipeline);
+	});
+	record_pass(FRAME_PASS_DOWNSAMPLE, recordPool, recordJobs, nullptr, [&](const vk::CommandBuffer& pass) {
+		run_downsample(pass, downsamplePipeline);
+	});
+	if (hierarchy) {
+		record_pass(FRAME_PASS_BVH, recordPool, recordJobs, nullptr, [&](const vk::CommandBuffer& pass) {
+			run_bvh(pass, *bvhPipeline, s.bvh(), queryPipeline.workgroup_size().x);
+		});
+	}
+	record_pass(FRAME_PASS_QUERY, recordPool, recordJobs, nullptr, [&](const vk::CommandBuffer& pass) {
+		run_query(pass, queryPipeline, meshes, objectsAmount, batchesAmount);
+	});
+	if (_settings.compactDraws) {
+		record_pass(FRAME_PASS_COMPACT, recordPool, recordJobs, nullptr, [&](const vk::CommandBuffer& pass) {
+			run_compaction(pass, compactPipeline, batchesAmount);
+		});
+	}
+	record_pass(FRAME_PASS_DRAW, recordPool, recordJobs, &drawPipeline, [&](const vk::CommandBuffer& pass) {
+		draw_final(pass, drawPipeline, meshes, *s.materials(), batchesAmount, finalSize);
+	});
+
+	_tuned_shapes.emplace_back(TUNED_KERNEL_COPY, copyPipeline.workgroup_size());
+	_tuned_shapes.emplace_back(TUNED_KERNEL_DOWNSAMPLE, downsamplePipeline.workgroup_size());
+	_tuned_shapes.emplace_back(TUNED_KERNEL_QUERY, queryPipeline.workgroup_size());
+
+	//Every job has to be done before rethrowing the first failure, they reference this frame's locals
+	for(auto& job : recordJobs) {
+		job.wait();
+	}
+	for(auto& job : recordJobs) {
+		job.get();
+	}
+
+	_graph.execute(cmd, _timer.get());
+	_queried_objects = s.objects().size();
+
+	_record_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+}
 
-	vk::ImageMemoryBarrier presentBarrier(vk::AccessFlagBits::eTransferWrite,
-										  vk::AccessFlagBits::eNone,
-										  vk::ImageLayout::eTransferDstOptimal,
-										  vk::ImageLayout::ePresentSrcKHR,
-										  VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-										  swapchainImg,
-										  {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+void FrameData::record_pass(uint32_t pass, ThreadPool* pool, std::vector<std::future<void>>& jobs, const GraphicsPipeline* rendering,
+							std::function<void(const vk::CommandBuffer&)> body) {
+	auto job = [this, pass, rendering, body = std::move(body)]() {
+		//The pool belongs to this pass only, so no other thread touches it while it's recorded
+		const auto& recorder = _passes[pass];
+		instance->device().resetCommandPool(recorder.pool);
+
+		vk::CommandBufferUsageFlags usage = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+		vk::CommandBufferInheritanceInfo inheritance;
+		vk::CommandBufferInheritanceRenderingInfo renderingInheritance;
+		if (rendering) {
+			usage |= vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+			renderingInheritance = rendering->inheritance_rendering_info();
+			inheritance.setPNext(&renderingInheritance);
+		}
+
+		recorder.buffer.begin(vk::CommandBufferBeginInfo(usage, &inheritance));
+		body(recorder.buffer);
+		recorder.buffer.end();
+	};
 
-	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, nullptr, nullptr, presentBarrier);
+	if (pool == nullptr) {
+		job();
+	} else {
+		jobs.push_back(pool->submit(std::move(job)));
+	}
 }
 
-void FrameData::update_descriptor_sets(const MeshBuffer& meshes) {
-	auto meshBufferInfo = vk::DescriptorBufferInfo(meshes.buffer()->buffer(),0, meshes.buffer()->size());
+void FrameData::update_descriptor_sets() {
 	auto uniformBufferInfo = vk::DescriptorBufferInfo(_cameraBuffer->buffer(), 0, _cameraBuffer->size());
-	auto instanceBufferInfo = vk::DescriptorBufferInfo(_instanceBuffer->buffer(), 0, _instanceBuffer->size());
-	auto indirectBufferInfo = vk::DescriptorBufferInfo(_indirectBuffer->buffer(), 0, _indirectBuffer->size());
-	auto clearBufferInfo = vk::DescriptorBufferInfo(_clearBuffer->buffer(), 0, _clearBuffer->size());
 
-	auto copySourceInfo = vk::DescriptorImageInfo(nearestSampler->sampler(), _hzBuffer.depth_view(), vk::ImageLayout::eShaderReadOnlyOptimal);
-	auto copyTargetInfo = vk::DescriptorImageInfo(nullptr, _hzBuffer.level_views()[0], vk::ImageLayout::eGeneral);
-	auto queryTextureInfo = vk::DescriptorImageInfo(nearestSampler->sampler(), _hzBuffer.full_view(), vk::ImageLayout::eShaderReadOnlyOptimal);
+	auto copySourceInfo = vk::DescriptorImageInfo(nearestSampler->sampler(), _hzBuffer->depth_view(), vk::ImageLayout::eShaderReadOnlyOptimal);
+	auto copyTargetInfo = vk::DescriptorImageInfo(nullptr, _hzBuffer->level_views()[0], vk::ImageLayout::eGeneral);
+	auto queryTextureInfo = vk::DescriptorImageInfo(maxSampler ? maxSampler->sampler() : nearestSampler->sampler(), _hzBuffer->full_view(), vk::ImageLayout::eShaderReadOnlyOptimal);
+	auto presentSourceInfo = vk::DescriptorImageInfo(nearestSampler->sampler(), _draw_color_view, vk::ImageLayout::eShaderReadOnlyOptimal);
 
 	std::vector<vk::WriteDescriptorSet> writes {
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_MESH_AND_CAMERA], 0, 0, vk::DescriptorType::eStorageBuffer, nullptr, meshBufferInfo, nullptr),
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_MESH_AND_CAMERA], 1, 0, vk::DescriptorType::eUniformBuffer, nullptr, uniformBufferInfo, nullptr),
-
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_INSTANCES_ONLY], 0, 0, vk::DescriptorType::eStorageBuffer, nullptr, instanceBufferInfo, nullptr),
+		vk::WriteDescriptorSet(descriptorSets[DS_ID_CAMERA_GRAPHICS], 0, 0, vk::DescriptorType::eUniformBuffer, nullptr, uniformBufferInfo, nullptr),
 
 		vk::WriteDescriptorSet(descriptorSets[DS_ID_COPY], 0, 0, vk::DescriptorType::eCombinedImageSampler, copySourceInfo, nullptr, nullptr),
 		vk::WriteDescriptorSet(descriptorSets[DS_ID_COPY], 1, 0, vk::DescriptorType::eStorageImage, copyTargetInfo, nullptr, nullptr),
 
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_CAMERA_ONLY], 0, 0, vk::DescriptorType::eUniformBuffer, nullptr, uniformBufferInfo, nullptr),
-
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_INSTANCES_AND_INDIRECTIONS_COMPUTE], 0, 0, vk::DescriptorType::eStorageBuffer, nullptr, instanceBufferInfo, nullptr),
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_INSTANCES_AND_INDIRECTIONS_COMPUTE], 1, 0, vk::DescriptorType::eStorageBuffer, nullptr, indirectBufferInfo, nullptr),
-
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_INSTANCES_AND_INDIRECTIONS_GRAPHICS], 0, 0, vk::DescriptorType::eStorageBuffer, nullptr, instanceBufferInfo, nullptr),
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_INSTANCES_AND_INDIRECTIONS_GRAPHICS], 1, 0, vk::DescriptorType::eStorageBuffer, nullptr, indirectBufferInfo, nullptr),
-
 		vk::WriteDescriptorSet(descriptorSets[DS_ID_QUERY], 0, 0, vk::DescriptorType::eCombinedImageSampler, queryTextureInfo, nullptr, nullptr),
-		vk::WriteDescriptorSet(descriptorSets[DS_ID_QUERY], 1, 0, vk::DescriptorType::eStorageBuffer, nullptr, clearBufferInfo, nullptr),
-
-		//vk::WriteDescriptorSet(descriptorSets[DS_ID_MATERIALS_AND_TEXTURES_0], 0, 0, vk::DescriptorType::eStorageBuffer, nullptr, )
 	};
 
+	if (!_settings.directPresent) {
+		writes.emplace_back(descriptorSets[DS_ID_PRESENT], 0, 0, vk::DescriptorType::eCombinedImageSampler, presentSourceInfo, nullptr, nullptr);
+	}
+
 	instance->device().updateDescriptorSets(writes, nullptr);
-	_descriptors_up_to_date = true;
 }
 
-void FrameData::run_z_pass(const vk::CommandBuffer& cmd, PipelineCollection &pipelines, int batchesAmount) {
-	const auto& zPassPipeline = pipelines.z_pass();
-	auto clearDepth = vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0));
+void FrameData::upload_scene_buffers(const vk::CommandBuffer& cmd, const SceneUpload& upload, size_t batchesAmount, size_t objectsAmount) {
+	//Staging buffers mirror the layout of the device buffers, so regions use the same offset on both sides
+	std::vector<vk::BufferCopy> instanceRegions;
+	instanceRegions.reserve(upload.instances.size());
+	for(const auto& range : upload.instances) {
+		auto offset = range.first * sizeof(ObjectInstance);
+		instanceRegions.emplace_back(offset, offset, range.count * sizeof(ObjectInstance));
+	}
+	_instanceBuffer.record_upload(cmd, instanceRegions);
 
+	if (upload.batches) {
+		_batchesBuffer.record_upload(cmd, vk::BufferCopy(0, 0, batchesAmount * sizeof(DrawBatch)));
+	}
 
-	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, zPassPipeline->pipeline_layout(), 0,
-						   {{ descriptorSets[DS_ID_MESH_AND_CAMERA], descriptorSets[DS_ID_INSTANCES_ONLY] }}, nullptr);
+	if (!_settings.hierarchicalCulling) {
+		return;
+	}
 
-	auto hzbSize = _hzBuffer.sizes()[0];
+	std::vector<vk::BufferCopy> nodeRegions;
+	nodeRegions.reserve(upload.nodes.size());
+	for(const auto& range : upload.nodes) {
+		auto offset = range.first * sizeof(BVHNode);
+		nodeRegions.emplace_back(offset, offset, range.count * sizeof(BVHNode));
+	}
+	_bvhNodeBuffer.record_upload(cmd, nodeRegions);
 
-	cmd.beginRenderPass({zPassPipeline->render_pass(), _z_framebuffer,
-								   {{ 0, 0 }, {(uint32_t)hzbSize.x, (uint32_t)hzbSize.y}},
-								   clearDepth}, vk::SubpassContents::eInline);
-	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, zPassPipeline->pipeline());
-	cmd.setViewport(0, {{0, 0, (float) hzbSize.x, (float)hzbSize.y, 0.0f, 1.0f}});
-	cmd.setScissor(0, {{{0, 0}, {(uint32_t) hzbSize.x, (uint32_t)hzbSize.y}}});
-	cmd.setCullMode(vk::CullModeFlagBits::eNone);
+	if (upload.leaves) {
+		_bvhLeafBuffer.record_upload(cmd, vk::BufferCopy(0, 0, objectsAmount * sizeof(uint32_t)));
+	}
+}
 
-	cmd.drawIndirect(_drawBuffer->buffer(), 0, batchesAmount, sizeof(VkDrawIndirectCommand));
+void FrameData::report_tuning(PipelineCollection& pipelines) {
+	auto& tuner = pipelines.workgroup_tuner();
+	if (_tuned_shapes.empty() || !tuner.tuning()) {
+		return;
+	}
 
-	cmd.endRenderPass();
+	//Called once the slot's fence was waited on, so these are the timings of its last submission
+	for(const auto& result : _timer->results()) {
+		for(const auto& [kernel, shape] : _tuned_shapes) {
+			if (kernel == result.name) {
+				tuner.report(kernel, shape, result.milliseconds);
+			}
+		}
+	}
 }
 
-void FrameData::run_copy_pass(const vk::CommandBuffer &cmd, PipelineCollection &pipelines) {
-	const auto& copyPipeline = pipelines.copy_pass();
+void FrameData::run_commands(const vk::CommandBuffer& cmd, const ComputePipeline& commandsPipeline, const MeshBuffer& meshes, int batchesAmount, int objectsAmount) {
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, commandsPipeline.pipeline());
 
-	auto hz_size = _hzBuffer.depth_texture().size();
+	CommandsConstants constants { _batchesBuffer.device_address(), meshes.table()->device_address(), _drawBuffer.device_address(), _clearBuffer.device_address(),
+								  _countBuffer->device_address(), (uint32_t) batchesAmount, _settings.compactDraws ? 1U : 0U,
+								  (uint32_t) objectsAmount, views_amount() };
+	cmd.pushConstants(commandsPipeline.pipeline_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(CommandsConstants), &constants);
 
-	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, copyPipeline->pipeline());
-	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, copyPipeline->pipeline_layout(), 0, descriptorSets[DS_ID_COPY], nullptr);
+	cmd.dispatch((batchesAmount + 63) / 64, 1, 1);
+}
 
-	cmd.dispatch(glm::max(1, hz_size.x / 16), glm::max(1, hz_size.y / 16), 1);
+void FrameData::run_compaction(const vk::CommandBuffer& cmd, const ComputePipeline& compactPipeline, int batchesAmount) {
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, compactPipeline.pipeline());
+
+	CompactConstants constants { _clearBuffer.device_address(), _visibleBuffer.device_address(), _countBuffer->device_address(), (uint32_t) batchesAmount,
+								 DRAW_COUNT_FINAL, views_amount(), 0 };
+	cmd.pushConstants(compactPipeline.pipeline_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(CompactConstants), &constants);
+
+	cmd.dispatch((batchesAmount * views_amount() + 63) / 64, 1, 1);
 }
 
-void FrameData::run_downsample(const vk::CommandBuffer &cmd, PipelineCollection &pipelines) {
-	const auto& downsamplePipeline = pipelines.downsample_pass();
-	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, downsamplePipeline->pipeline());
-	for (uint32_t level = 1; level < _hzBuffer.texture().levels(); level++) {
-		vk::MemoryBarrier barrier { vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead };
+void FrameData::run_z_pass(const vk::CommandBuffer& cmd, const GraphicsPipeline& zPassPipeline, const MeshBuffer& meshes, int batchesAmount) {
+	ZPassConstants constants { meshes.buffer()->device_address(), _instanceBuffer.device_address() };
 
-		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
-							{}, {{ barrier }}, nullptr, nullptr);
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, zPassPipeline.pipeline_layout(), 0, descriptorSets[DS_ID_CAMERA_GRAPHICS], nullptr);
+	cmd.pushConstants(zPassPipeline.pipeline_layout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(ZPassConstants), &constants);
 
-		cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, downsamplePipeline->pipeline_layout(), 0, _hzBuffer.downsample_descriptor_sets()[level - 1], nullptr);
+	auto hzbSize = _hzBuffer->sizes()[0];
 
-		auto size = _hzBuffer.sizes()[level];
+	//Recorded inside the rendering instance begun by the primary buffer
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, zPassPipeline.pipeline());
+	cmd.setViewport(0, {{0, 0, (float) hzbSize.x, (float)hzbSize.y, 0.0f, 1.0f}});
+	cmd.setScissor(0, {{{0, 0}, {(uint32_t) hzbSize.x, (uint32_t)hzbSize.y}}});
+	cmd.setCullMode(vk::CullModeFlagBits::eNone);
 
-		cmd.dispatch(glm::max(1, size.x / 16), glm::max(1, size.y / 16), 1);
+	if (_settings.compactDraws) {
+		cmd.drawIndirectCount(_drawBuffer.buffer()->buffer(), 0, _countBuffer->buffer(), DRAW_COUNT_Z_PASS * sizeof(uint32_t), batchesAmount, sizeof(VkDrawIndirectCommand));
+	} else {
+		cmd.drawIndirect(_drawBuffer.buffer()->buffer(), 0, batchesAmount, sizeof(VkDrawIndirectCommand));
 	}
 }
 
-void FrameData::run_query(const vk::CommandBuffer &cmd, PipelineCollection &pipelines, int objectsAmount) {
-	const auto& queryPipeline = pipelines.query_pass();
-	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, queryPipeline->pipeline());
+void FrameData::run_copy_pass(const vk::CommandBuffer &cmd, const ComputePipeline& copyPipeline) {
+	auto hz_size = _hzBuffer->depth_texture().size();
 
-	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, queryPipeline->pipeline_layout(), 0,
-						   {{descriptorSets[DS_ID_CAMERA_ONLY], descriptorSets[DS_ID_INSTANCES_AND_INDIRECTIONS_COMPUTE], descriptorSets[DS_ID_QUERY] }},
-						   nullptr);
-	cmd.pushConstants(queryPipeline->pipeline_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &objectsAmount);
-	auto amount = objectsAmount % 16 == 0 ? objectsAmount / 16 : static_cast<int>(std::ceil(objectsAmount / 16.0f));
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, copyPipeline.pipeline());
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, copyPipeline.pipeline_layout(), 0, descriptorSets[DS_ID_COPY], nullptr);
 
-	cmd.dispatch(amount, 1, 1);
+	auto groups = copyPipeline.group_count(glm::uvec2(hz_size));
+	cmd.dispatch(groups.x, groups.y, 1);
 }
 
-void FrameData::update_draw_fb(PipelineCollection &pipelines, glm::ivec2 size) {
-	if (_draw_frame_buffer) {
-		instance->device().destroyFramebuffer(_draw_frame_buffer);
-	}
-
-	if (_draw_color_view) {
-		instance->device().destroyImageView(_draw_color_view);
-	}
+void FrameData::run_downsample(const vk::CommandBuffer &cmd, const ComputePipeline& downsamplePipeline) {
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, downsamplePipeline.pipeline());
+	for (uint32_t level = 1; level < _hzBuffer->texture().levels(); level++) {
+		vk::MemoryBarrier barrier { vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead };
 
-	if (_draw_depth_view) {
-		instance->device().destroyImageView(_draw_depth_view);
-	}
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+							{}, {{ barrier }}, nullptr, nullptr);
 
-	_draw_color = std::make_unique<Texture>(instance, PIPELINE_COLOR_FORMAT, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment, size, 1);
-	_draw_depth = std::make_unique<Texture>(instance, PIPELINE_DEPTH_FORMAT, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment, size, 1);
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, downsamplePipeline.pipeline_layout(), 0, _hzBuffer->downsample_descriptor_sets()[level - 1], nullptr);
 
-	vk::ComponentMapping mapping = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA };
-	_draw_color_view = instance->device().createImageView(vk::ImageViewCreateInfo({}, _draw_color->image(), vk::ImageViewType::e2D, PIPELINE_COLOR_FORMAT, mapping,
-																				  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)));
+		auto size = _hzBuffer->sizes()[level];
 
-	_draw_depth_view = instance->device().createImageView(vk::ImageViewCreateInfo({}, _draw_depth->image(), vk::ImageViewType::e2D, PIPELINE_DEPTH_FORMAT, mapping,
-																				  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1)));
+		auto groups = downsamplePipeline.group_count(glm::uvec2(size));
+		cmd.dispatch(groups.x, groups.y, 1);
+	}
+}
 
-	std::array<vk::ImageView, 2> views {
-		_draw_color_view,
-		_draw_depth_view
-	};
+void FrameData::run_bvh(const vk::CommandBuffer &cmd, const ComputePipeline& bvhPipeline, const InstanceBVH& bvh, uint32_t queryGroupSize) {
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, bvhPipeline.pipeline());
+	//Same binding as the query pass, so its set is compatible
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, bvhPipeline.pipeline_layout(), 0, descriptorSets[DS_ID_QUERY], nullptr);
+
+	//One dispatch per level, sized on the GPU by the visible nodes of the level before
+	const auto& levels = bvh.levels();
+	for(uint32_t level = 0; level < levels.size(); level++) {
+		if (level > 0) {
+			vk::MemoryBarrier2 barrier(vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+									   vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eComputeShader,
+									   vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+			cmd.pipelineBarrier2(vk::DependencyInfo({}, barrier, nullptr, nullptr));
+		}
+
+		BVHConstants constants { _bvhNodeBuffer.device_address(), _bvhLeafBuffer.device_address(), _bvhQueueBuffer.device_address(), _bvhListBuffer->device_address(),
+								 _candidateBuffer.device_address(), _viewBuffer->device_address(), _countBuffer->device_address(), level, levels[level].first,
+								 level + 1 < levels.size() ? levels[level + 1].first : 0, views_amount(), queryGroupSize, DRAW_COUNT_BVH_NODES };
+		cmd.pushConstants(bvhPipeline.pipeline_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(BVHConstants), &constants);
+		cmd.dispatchIndirect(_bvhListBuffer->buffer(), level * sizeof(DispatchList));
+	}
+}
 
-	vk::FramebufferCreateInfo info({}, pipelines.draw_pass()->render_pass(), views, size.x, size.y, 1);
-	_draw_frame_buffer = instance->device().createFramebuffer(info);
+void FrameData::run_query(const vk::CommandBuffer &cmd, const ComputePipeline& queryPipeline, const MeshBuffer& meshes, int objectsAmount, int batchesAmount) {
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, queryPipeline.pipeline());
+
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, queryPipeline.pipeline_layout(), 0,
+						   descriptorSets[DS_ID_QUERY], nullptr);
+
+	QueryConstants constants { _instanceBuffer.device_address(), _indirectBuffer.device_address(), _clearBuffer.device_address(), _visibleInstancesBuffer.device_address(),
+							   meshes.table()->device_address(), _viewBuffer->device_address(), _countBuffer->device_address(),
+							   _visibility ? _visibility->history()->device_address() : 0,
+							   _settings.hierarchicalCulling ? _candidateBuffer.device_address() : 0, (uint32_t) objectsAmount, (uint32_t) batchesAmount, views_amount(),
+							   DRAW_COUNT_VISIBLE, _visibility_frame, HISTORY_FLAG_NONE, 1, 1, 0.0f, _settings.hierarchicalCulling ? 1U : 0U };
+	if (_visibility) {
+		const auto& cache = _visibility->settings();
+		constants.historyFlags = HISTORY_FLAG_ENABLED | (cache.validate ? HISTORY_FLAG_VALIDATE : HISTORY_FLAG_NONE);
+		constants.historyAgree = cache.agreeFrames;
+		constants.historyPeriod = cache.refreshPeriod;
+		constants.historyThreshold = cache.moveThreshold;
+	}
+	cmd.pushConstants(queryPipeline.pipeline_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(QueryConstants), &constants);
+	//The traversal sized the dispatch over the instances of the leaves it kept
+	if (_settings.hierarchicalCulling) {
+		cmd.dispatchIndirect(_candidateBuffer.buffer()->buffer(), 0);
+	} else {
+		cmd.dispatch(queryPipeline.group_count(glm::uvec2(objectsAmount, 1)).x, 1, 1);
+	}
 }
 
-void FrameData::draw_final(const vk::CommandBuffer &cmd, PipelineCollection &pipelines, int batches_amount,
-						   glm::ivec2 size) {
-	const auto& drawPipeline = pipelines.draw_pass();
-	auto clearColor = vk::ClearValue(vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f));
-	auto clearDepth = vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0));
+void FrameData::draw_final(const vk::CommandBuffer &cmd, const GraphicsPipeline& drawPipeline, const MeshBuffer& meshes, const MaterialLibrary& materials,
+						   int batches_amount, glm::ivec2 size) {
+	DrawConstants constants { meshes.buffer()->device_address(), _visibleInstancesBuffer.device_address(), materials.table()->device_address(), materials.material_count(), 0 };
 
-	std::array<vk::ClearValue, 2> clears = {
-			clearColor, clearDepth
-	};
+	//Every material is drawn through the same texture array, bound once for all batches
+	std::array<vk::DescriptorSet, 2> sets { descriptorSets[DS_ID_CAMERA_GRAPHICS], materials.descriptor_set() };
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, drawPipeline.pipeline_layout(), 0, sets, nullptr);
+	cmd.pushConstants(drawPipeline.pipeline_layout(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(DrawConstants), &constants);
 
-	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, drawPipeline->pipeline_layout(), 0,
-						   {{ descriptorSets[DS_ID_MESH_AND_CAMERA], descriptorSets[DS_ID_INSTANCES_AND_INDIRECTIONS_GRAPHICS] }}, nullptr);
+	//Recorded inside the rendering instance begun by the primary buffer
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, drawPipeline.pipeline());
+	cmd.setViewport(0, {{0, 0, (float) size.x, (float)size.y, 0.0f, 1.0f}});
+	cmd.setScissor(0, {{{0, 0}, {(uint32_t) size.x, (uint32_t)size.y}}});
+	cmd.setCullMode(vk::CullModeFlagBits::eNone);
 
+	if (_settings.compactDraws) {
+		cmd.drawIndirectCount(_visibleBuffer.buffer()->buffer(), 0, _countBuffer->buffer(), DRAW_COUNT_FINAL * sizeof(uint32_t), batches_amount, sizeof(VkDrawIndirectCommand));
+	} else {
+		cmd.drawIndirect(_clearBuffer.buffer()->buffer(), 0, batches_amount, sizeof(VkDrawIndirectCommand));
+	}
+}
+
+void FrameData::run_present(const vk::CommandBuffer &cmd, const GraphicsPipeline& presentPipeline, const vk::ImageView& target, glm::ivec2 size) {
+	//Every pixel is written, so the previous contents of the swapchain image are never loaded
+	vk::RenderingAttachmentInfo color(target, vk::ImageLayout::eColorAttachmentOptimal, vk::ResolveModeFlagBits::eNone, nullptr,
+									  vk::ImageLayout::eUndefined, vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eStore);
+	cmd.beginRendering(vk::RenderingInfo({}, {{ 0, 0 }, {(uint32_t)size.x, (uint32_t)size.y}}, 1, 0, color));
 
-	cmd.beginRenderPass({drawPipeline->render_pass(), _draw_frame_buffer,
-						 {{ 0, 0 }, {(uint32_t)size.x, (uint32_t)size.y}},
-						 clears}, vk::SubpassContents::eInline);
-	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, drawPipeline->pipeline());
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, presentPipeline.pipeline());
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, presentPipeline.pipeline_layout(), 0, descriptorSets[DS_ID_PRESENT], nullptr);
 	cmd.setViewport(0, {{0, 0, (float) size.x, (float)size.y, 0.0f, 1.0f}});
 	cmd.setScissor(0, {{{0, 0}, {(uint32_t) size.x, (uint32_t)size.y}}});
 	cmd.setCullMode(vk::CullModeFlagBits::eNone);
+	cmd.draw(3, 1, 0, 0);
 
-	cmd.drawIndirect(_clearBuffer->buffer(), 0, batches_amount, sizeof(VkDrawIndirectCommand));
-
-	cmd.endRenderPass();
+	cmd.endRendering();
 }
 
@@ -14,57 +14,188 @@
 #include "PipelineCollection.h"
 #include "Sampler.h"
 #include "Texture.h"
+#include "DynamicBuffer.h"
+#include "GpuTimer.h"
+#include "ThreadPool.h"
+#include "FrameGraph.h"
+#include "VisibilityCache.h"
+#include <array>
+#include <future>
+#include <functional>
+
+#define FRAME_TIMER_REGIONS 12
+// Main camera included
+#define FRAME_MAX_VIEWS 8
+
+// Passes recorded into their own secondary command buffer
+#define FRAME_PASS_COMMANDS 0
+#define FRAME_PASS_Z 1
+#define FRAME_PASS_COPY 2
+#define FRAME_PASS_DOWNSAMPLE 3
+#define FRAME_PASS_QUERY 4
+#define FRAME_PASS_COMPACT 5
+#define FRAME_PASS_DRAW 6
+#define FRAME_PASS_BVH 7
+#define FRAME_PASS_COUNT 8
+
+// Draw counters in _countBuffer, views after the first one count into the following entries
+#define DRAW_COUNT_Z_PASS 0
+#define DRAW_COUNT_FINAL 1
+// Visible instances of the main view, after the counters of every view
+#define DRAW_COUNT_VISIBLE (DRAW_COUNT_FINAL + FRAME_MAX_VIEWS)
+// Main view results taken from the visibility history, and those of them that hid a visible instance
+#define DRAW_COUNT_REUSED (DRAW_COUNT_VISIBLE + 1)
+#define DRAW_COUNT_STALE (DRAW_COUNT_VISIBLE + 2)
+// Hierarchy nodes the traversal tested
+#define DRAW_COUNT_BVH_NODES (DRAW_COUNT_VISIBLE + 3)
+// Entry of the readback buffer after the copied counters, holds the instances the traversal passed to the query
+#define READBACK_CANDIDATES (DRAW_COUNT_BVH_NODES - DRAW_COUNT_VISIBLE + 1)
+
+struct FrameSettings {
+	// Where the per-frame scene buffers live, device local ones are filled through staging copies
+	BufferPlacement sceneBufferPlacement = BufferPlacement::eHostVisible;
+	// Only draw batches with instances, through vkCmdDrawIndirectCount
+	bool compactDraws = true;
+	// Views culled along with the main camera, such as shadow cascades. At most FRAME_MAX_VIEWS - 1
+	uint32_t secondaryViews = 0;
+	// Draw straight into the swapchain image. Otherwise the frame is drawn into an image of its own and
+	// written to the swapchain by a full-screen pass, the place for post processing
+	bool directPresent = true;
+	// Size of the HZB for a given render size, applied on resize
+	HZBPolicy hzb;
+	// Cull the scene's instance hierarchy first, only instances in visible leaves are tested one by one
+	bool hierarchicalCulling = true;
+};
 
 class FrameData {
 private:
 	std::shared_ptr<Instance> instance;
 	uint32_t _index;
 	vk::CommandBuffer _command_buffer;
-	vk::Framebuffer _z_framebuffer;
-	vk::Framebuffer _draw_frame_buffer;
-	std::unique_ptr<Texture> _draw_color;
+	// Only created when the frame is not drawn into the swapchain image directly
 	vk::ImageView _draw_color_view;
-	std::unique_ptr<Texture> _draw_depth;
 	vk::ImageView _draw_depth_view;
 	vk::Fence _in_flight_fence;
-	vk::Semaphore _render_in_progress_semaphore;
+
+	// Barriers between the passes and the memory of the images only used within the frame
+	FrameGraph _graph;
+	struct GraphResources {
+		FrameGraphResource hzbDepth;
+		FrameGraphResource hzb;
+		FrameGraphResource drawColor;
+		FrameGraphResource drawDepth;
+		FrameGraphResource swapchain;
+		// Instances, batches and the instance hierarchy
+		FrameGraphResource scene;
+		FrameGraphResource counts;
+		FrameGraphResource drawCommands;
+		// Per view commands the query pass counts into
+		FrameGraphResource viewCommands;
+		// Indirections and visible instances
+		FrameGraphResource visible;
+		FrameGraphResource compacted;
+		FrameGraphResource readback;
+		FrameGraphResource history;
+		// Node queues, their dispatch lists and the candidates the traversal leaves for the query pass
+		FrameGraphResource traversal;
+	} _resources;
+
+	// Every pass has its own pool, so passes can be recorded on different threads at the same time
+	struct PassRecorder {
+		vk::CommandPool pool;
+		vk::CommandBuffer buffer;
+	};
+	std::array<PassRecorder, FRAME_PASS_COUNT> _passes;
+	double _record_milliseconds;
 
 	std::unique_ptr<Buffer> _cameraBuffer;
-	std::unique_ptr<Buffer> _instanceBuffer;
-	std::unique_ptr<Buffer> _batchesBuffer;
-	std::unique_ptr<Buffer> _drawBuffer;
-	std::unique_ptr<Buffer> _clearBuffer;
-	std::unique_ptr<Buffer> _indirectBuffer;
+	// ViewData of the main camera followed by the secondary views
+	std::unique_ptr<Buffer> _viewBuffer;
+	FrameSettings _settings;
+	DynamicBuffer _instanceBuffer;
+	DynamicBuffer _batchesBuffer;
+	DynamicBuffer _drawBuffer;
+	// Visible instances per batch, one range of batches per view
+	DynamicBuffer _clearBuffer;
+	// Indices of visible instances, one range of instances per view
+	DynamicBuffer _indirectBuffer;
+	// VisibleInstance for every indirection of the main view, written by the query pass
+	DynamicBuffer _visibleInstancesBuffer;
+	// Non-empty commands of _clearBuffer, and the amount of commands in the compacted lists
+	DynamicBuffer _visibleBuffer;
+	// Nodes and leaf instances of the scene's hierarchy, placed like the other scene buffers
+	DynamicBuffer _bvhNodeBuffer;
+	DynamicBuffer _bvhLeafBuffer;
+	// Nodes each level of the traversal tests, in the same ranges as the levels of the node buffer
+	DynamicBuffer _bvhQueueBuffer;
+	// DispatchList of the candidates followed by their instance slots
+	DynamicBuffer _candidateBuffer;
+	// DispatchList per hierarchy level
+	std::unique_ptr<Buffer> _bvhListBuffer;
+	uint32_t _bvh_nodes;
+	uint32_t _bvh_levels;
+	std::unique_ptr<Buffer> _countBuffer;
+	// Host visible copy of DRAW_COUNT_VISIBLE to DRAW_COUNT_BVH_NODES and the candidate count, written at the end of the frame
+	std::unique_ptr<Buffer> _readbackBuffer;
+	// Shared with the other slots, null when disabled
+	std::shared_ptr<VisibilityCache> _visibility;
+	uint32_t _visibility_frame;
+	uint64_t _layout_version;
+
+	// Scene version these buffers were last filled with
+	uint64_t _uploaded_version;
+	size_t _uploaded_bytes;
+
+	std::unique_ptr<GpuTimer> _timer;
+	uint32_t _queried_objects;
+	// Workgroup shapes the tuned kernels were recorded with, matched to timer regions of the same name
+	std::vector<std::pair<std::string_view, glm::uvec2>> _tuned_shapes;
 
 	std::vector<vk::DescriptorSet> descriptorSets;
 	std::unique_ptr<Sampler> linearSampler;
 	std::unique_ptr<Sampler> nearestSampler;
-	std::unique_ptr<Texture> whiteTexture;
-	bool _descriptors_up_to_date;
-	HZBuffer _hzBuffer;
-
-	void update_descriptor_sets(const MeshBuffer& meshes);
-
-	void run_z_pass(const vk::CommandBuffer& cmd, PipelineCollection& pipelines, int batches_amount);
-	void run_copy_pass(const vk::CommandBuffer& cmd, PipelineCollection& pipelines);
-	void run_downsample(const vk::CommandBuffer& cmd, PipelineCollection& pipelines);
-	void run_query(const vk::CommandBuffer& cmd, PipelineCollection& pipelines, int objects_amount);
-	void draw_final(const vk::CommandBuffer& cmd, PipelineCollection& pipelines, int batches_amount, glm::ivec2 size);
-	void update_draw_fb(PipelineCollection& pipelines, glm::ivec2 size);
+	// Linear with max reduction, builds and queries the HZB when PipelineCollection::hzb_reduction()
+	std::unique_ptr<Sampler> maxSampler;
+	// Built on the graph's images, recreated along with them
+	std::unique_ptr<HZBuffer> _hzBuffer;
+	vk::Sampler _downsample_sampler;
+
+	void declare_resources(vk::Format colorFormat, glm::ivec2 drawSize);
+	void destroy_graph_views();
+	// Recreates everything referencing the graph's images after compile() replaced them
+	void on_graph_resources_changed(PipelineCollection& pipelines);
+	void update_descriptor_sets();
+	void report_tuning(PipelineCollection& pipelines);
+	void upload_scene_buffers(const vk::CommandBuffer& cmd, const SceneUpload& upload, size_t batchesAmount, size_t objectsAmount);
+
+	// Records 'body' into the secondary buffer of 'pass', as a job on 'pool' or right away without one.
+	// Passes drawing inside a rendering instance pass the pipeline whose attachments it uses for inheritance
+	void record_pass(uint32_t pass, ThreadPool* pool, std::vector<std::future<void>>& jobs, const GraphicsPipeline* rendering,
+					 std::function<void(const vk::CommandBuffer&)> body);
+
+	void run_commands(const vk::CommandBuffer& cmd, const ComputePipeline& pipeline, const MeshBuffer& meshes, int batches_amount, int objects_amount);
+	void run_z_pass(const vk::CommandBuffer& cmd, const GraphicsPipeline& pipeline, const MeshBuffer& meshes, int batches_amount);
+	void run_copy_pass(const vk::CommandBuffer& cmd, const ComputePipeline& pipeline);
+	void run_downsample(const vk::CommandBuffer& cmd, const ComputePipeline& pipeline);
+	void run_compaction(const vk::CommandBuffer& cmd, const ComputePipeline& pipeline, int batches_amount);
+	void run_bvh(const vk::CommandBuffer& cmd, const ComputePipeline& pipeline, const InstanceBVH& bvh, uint32_t queryGroupSize);
+	void run_query(const vk::CommandBuffer& cmd, const ComputePipeline& pipeline, const MeshBuffer& meshes, int objects_amount, int batches_amount);
+	void draw_final(const vk::CommandBuffer& cmd, const GraphicsPipeline& pipeline, const MeshBuffer& meshes, const MaterialLibrary& materials, int batches_amount, glm::ivec2 size);
+	void run_present(const vk::CommandBuffer& cmd, const GraphicsPipeline& pipeline, const vk::ImageView& target, glm::ivec2 size);
 public:
-	FrameData(std::shared_ptr<Instance> instance, int index, const Swapchain& swapchain, glm::ivec2 hzBufferSize,
-			  PipelineCollection& pipelines, const vk::Sampler& downsampleSampler);
+	FrameData(std::shared_ptr<Instance> instance, int index, const Swapchain& swapchain, PipelineCollection& pipelines, const vk::Sampler& downsampleSampler,
+			  const FrameSettings& settings, std::shared_ptr<VisibilityCache> visibility = nullptr);
 
 	FrameData(const FrameData&) = delete;
 	FrameData(const FrameData&&) = delete;
 	~FrameData();
 
-	void draw(const vk::CommandBuffer& cmd, Scene& s, const UniformData& camera, PipelineCollection& pipelines, const vk::Image& swapchainImg, glm::ivec2 finalSize);
-
-	inline const vk::Framebuffer& z_framebuffer() const {
-		return _z_framebuffer;
-	}
-
+	// Passes are recorded in parallel on 'recordPool' when given, 'cmd' itself is only touched by the calling thread
+	void draw(const vk::CommandBuffer& cmd, Scene& s, PipelineCollection& pipelines, const vk::Image& swapchainImg, const vk::ImageView& swapchainView,
+			  glm::ivec2 finalSize, ThreadPool* recordPool = nullptr);
+	// Writes the camera used by this frame and the secondary views culled with it, which must be FrameSettings::secondaryViews.
+	// Call after recording and as close to submission as possible
+	void latch_camera(const UniformData& camera, const std::vector<ViewData>& secondaryViews = {});
 
 	inline const vk::CommandBuffer& command_buffer() const {
 		return _command_buffer;
@@ -74,17 +205,99 @@ public:
 		return _in_flight_fence;
 	}
 
-	inline const vk::Semaphore& render_in_progress_semaphore() const {
-		return _render_in_progress_semaphore;
+	// Null until the first frame was recorded
+	inline const std::unique_ptr<HZBuffer>& hz_buffer() const {
+		return _hzBuffer;
 	}
 
-	inline const HZBuffer& hz_buffer() const {
-		return _hzBuffer;
+	inline bool hzb_reduction() const {
+		return maxSampler != nullptr;
+	}
+
+	inline const FrameGraph& frame_graph() const {
+		return _graph;
 	}
 
 	inline uint32_t index() const {
 		return _index;
 	}
+
+	// Null when the device can't write timestamps
+	inline const std::unique_ptr<GpuTimer>& gpu_timer() const {
+		return _timer;
+	}
+
+	// Amount of objects tested by the query pass of the last recorded frame
+	inline uint32_t queried_objects() const {
+		return _queried_objects;
+	}
+
+	// Instances the main view found visible in the last submitted frame, only valid once its fence was waited on
+	inline uint32_t visible_objects() const {
+		return static_cast<const uint32_t*>(_readbackBuffer->persistent_mapping())[0];
+	}
+
+	// Main view results of the last submitted frame that came from the visibility history
+	inline uint32_t reused_objects() const {
+		return static_cast<const uint32_t*>(_readbackBuffer->persistent_mapping())[DRAW_COUNT_REUSED - DRAW_COUNT_VISIBLE];
+	}
+
+	// Reused results that hid a visible instance, only counted when validating the visibility cache
+	inline uint32_t stale_objects() const {
+		return static_cast<const uint32_t*>(_readbackBuffer->persistent_mapping())[DRAW_COUNT_STALE - DRAW_COUNT_VISIBLE];
+	}
+
+	// Hierarchy nodes tested in the last submitted frame, only valid once its fence was waited on
+	inline uint32_t tested_nodes() const {
+		return static_cast<const uint32_t*>(_readbackBuffer->persistent_mapping())[DRAW_COUNT_BVH_NODES - DRAW_COUNT_VISIBLE];
+	}
+
+	// Instances in the visible leaves of the last submitted frame, the ones the query pass tested
+	inline uint32_t candidate_objects() const {
+		return static_cast<const uint32_t*>(_readbackBuffer->persistent_mapping())[READBACK_CANDIDATES];
+	}
+
+	// Size of the hierarchy traversed by the last recorded frame, 0 when hierarchical culling is off
+	inline uint32_t hierarchy_nodes() const {
+		return _bvh_nodes;
+	}
+
+	inline uint32_t hierarchy_levels() const {
+		return _bvh_levels;
+	}
+
+	// Bytes written into the scene buffers by the last recorded frame
+	inline size_t uploaded_bytes() const {
+		return _uploaded_bytes;
+	}
+
+	// CPU time the last draw call spent recording, waiting on its jobs included
+	inline double record_milliseconds() const {
+		return _record_milliseconds;
+	}
+
+	inline const FrameSettings& settings() const {
+		return _settings;
+	}
+
+	inline uint32_t views_amount() const {
+		return _settings.secondaryViews + 1;
+	}
+
+	// Culled draw commands, view v owns the batches_amount commands starting at v * batches_amount.
+	// When compacting, only the first counts[DRAW_COUNT_FINAL + v] of them are valid
+	inline const DynamicBuffer& view_commands() const {
+		return _settings.compactDraws ? _visibleBuffer : _clearBuffer;
+	}
+
+	// Instance indices secondary views draw through, indexed by their commands' instances
+	inline const DynamicBuffer& view_indirections() const {
+		return _indirectBuffer;
+	}
+
+	inline const std::unique_ptr<Buffer>& draw_counts() const {
+		return _countBuffer;
+	}
 };
 
 
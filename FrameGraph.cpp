@@ -0,0 +1,343 @@
+#include "FrameGraph.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include "Buffer.h"
+
+static const vk::AccessFlags2 FRAME_GRAPH_WRITE_ACCESS = vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eColorAttachmentWrite |
+														 vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite |
+														 vk::AccessFlagBits2::eMemoryWrite;
+
+FrameGraph::FrameGraph(std::shared_ptr<Instance> inst) : instance(std::move(inst)), _transient_bytes(0), _allocated_bytes(0), _planned(false),
+														 _culled_passes(0), _barrier_batches(0) {
+
+}
+
+FrameGraph::~FrameGraph() {
+	release();
+}
+
+FrameGraphResource FrameGraph::create_image(std::string_view name, const FrameGraphImageDesc& desc, vk::ImageAspectFlags aspect) {
+	_resources.push_back({ name, true, true, desc, aspect, vk::ImageLayout::eUndefined, {}, {}, nullptr, nullptr, 0, 0, 0 });
+	return _resources.size() - 1;
+}
+
+FrameGraphResource FrameGraph::import_image(std::string_view name, vk::ImageAspectFlags aspect, vk::ImageLayout finalLayout) {
+	_resources.push_back({ name, true, false, {}, aspect, finalLayout, {}, {}, nullptr, nullptr, 0, 0, 0 });
+	return _resources.size() - 1;
+}
+
+FrameGraphResource FrameGraph::import_buffer(std::string_view name, vk::PipelineStageFlags2 previousStages, vk::AccessFlags2 previousAccess) {
+	_resources.push_back({ name, false, false, {}, {}, vk::ImageLayout::eUndefined, previousStages, previousAccess, nullptr, nullptr, 0, 0, 0 });
+	return _resources.size() - 1;
+}
+
+void FrameGraph::set_image(FrameGraphResource resource, const vk::Image& image) {
+	if (_resources[resource].transient) {
+		throw std::runtime_error("Frame graph image " + std::string(_resources[resource].name) + " is owned by the graph");
+	}
+
+	_resources[resource].handle = image;
+}
+
+void FrameGraph::set_desc(FrameGraphResource resource, const FrameGraphImageDesc& desc) {
+	_resources[resource].desc = desc;
+}
+
+void FrameGraph::add_pass(std::string_view name, std::vector<FrameGraphAccess> accesses, std::function<void(const vk::CommandBuffer&)> record, bool sideEffects) {
+	_passes.push_back({ name, std::move(accesses), std::move(record), sideEffects, false });
+}
+
+void FrameGraph::cull() {
+	//Walk back from the passes with visible results, keeping the writers of everything they read
+	std::vector<bool> needed(_resources.size(), false);
+	_culled_passes = 0;
+
+	for(auto pass = _passes.rbegin(); pass != _passes.rend(); pass++) {
+		bool keep = pass->sideEffects;
+		for(const auto& a : pass->accesses) {
+			const auto& r = _resources[a.resource];
+			bool presented = r.image && !r.transient && r.finalLayout != vk::ImageLayout::eUndefined;
+			if ((a.access & FRAME_GRAPH_WRITE_ACCESS) && (needed[a.resource] || presented)) {
+				keep = true;
+			}
+		}
+
+		pass->culled = !keep;
+		if (!keep) {
+			_culled_passes++;
+			continue;
+		}
+
+		for(const auto& a : pass->accesses) {
+			if (a.discard) {
+				needed[a.resource] = false;
+			} else if (a.access & ~FRAME_GRAPH_WRITE_ACCESS) {
+				needed[a.resource] = true;
+			}
+		}
+	}
+}
+
+bool FrameGraph::compile() {
+	cull();
+
+	for(auto& r : _resources) {
+		r.firstPass = UINT32_MAX;
+		r.lastPass = 0;
+	}
+
+	for(uint32_t i = 0; i < _passes.size(); i++) {
+		if (_passes[i].culled) {
+			continue;
+		}
+
+		for(const auto& a : _passes[i].accesses) {
+			auto& r = _resources[a.resource];
+			r.firstPass = std::min(r.firstPass, i);
+			r.lastPass = std::max(r.lastPass, i);
+		}
+	}
+
+	//Transient images are only recreated when their descriptions or lifetimes change, like on resize
+	std::vector<std::tuple<FrameGraphImageDesc, uint32_t, uint32_t>> plan;
+	for(const auto& r : _resources) {
+		if (r.transient) {
+			plan.emplace_back(r.desc, r.firstPass, r.lastPass);
+		}
+	}
+
+	if (_planned && plan == _plan) {
+		return false;
+	}
+
+	_plan = std::move(plan);
+	allocate();
+	_planned = true;
+	return true;
+}
+
+void FrameGraph::release() {
+	for(auto& r : _resources) {
+		if (r.transient) {
+			r.texture = nullptr;
+			r.handle = nullptr;
+		}
+	}
+
+	for(auto& block : _blocks) {
+		instance->device().freeMemory(block);
+	}
+	_blocks.clear();
+}
+
+void FrameGraph::allocate() {
+	release();
+
+	std::vector<FrameGraphResource> transients;
+	for(uint32_t i = 0; i < _resources.size(); i++) {
+		auto& r = _resources[i];
+		//Images no kept pass uses are not created at all
+		if (!r.transient || r.firstPass > r.lastPass) {
+			continue;
+		}
+
+		r.texture = std::make_unique<Texture>(instance, r.desc.format, r.desc.usage, r.desc.size, r.desc.levels, TextureMemory::eExternal);
+		r.handle = r.texture->image();
+		transients.push_back(i);
+	}
+
+	std::vector<vk::MemoryRequirements> requirements(_resources.size());
+	for(auto i : transients) {
+		requirements[i] = _resources[i].texture->memory_requirements();
+	}
+
+	//Largest first, each image goes into the first block with compatible memory whose images it never overlaps
+	std::sort(transients.begin(), transients.end(), [&requirements](auto a, auto b) { return requirements[a].size > requirements[b].size; });
+
+	struct Block {
+		vk::DeviceSize size;
+		uint32_t memoryTypes;
+		std::vector<FrameGraphResource> images;
+	};
+	std::vector<Block> blocks;
+
+	_transient_bytes = 0;
+	for(auto i : transients) {
+		auto& r = _resources[i];
+		const auto& required = requirements[i];
+		_transient_bytes += required.size;
+
+		auto overlaps = [this, &r](FrameGraphResource other) {
+			const auto& o = _resources[other];
+			return r.firstPass <= o.lastPass && o.firstPass <= r.lastPass;
+		};
+
+		auto block = std::find_if(blocks.begin(), blocks.end(), [&](const Block& b) {
+			return (b.memoryTypes & required.memoryTypeBits) != 0 && std::none_of(b.images.begin(), b.images.end(), overlaps);
+		});
+
+		if (block == blocks.end()) {
+			blocks.push_back({ 0, required.memoryTypeBits, {} });
+			block = std::prev(blocks.end());
+		}
+
+		block->size = std::max(block->size, required.size);
+		block->memoryTypes &= required.memoryTypeBits;
+		block->images.push_back(i);
+		r.block = std::distance(blocks.begin(), block);
+	}
+
+	_allocated_bytes = 0;
+	for(const auto& b : blocks) {
+		auto type = Buffer::findMemoryType(instance->memory_properties().memoryTypes, b.memoryTypes, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		_blocks.push_back(instance->device().allocateMemory({ b.size, type }));
+		_allocated_bytes += b.size;
+
+		for(auto i : b.images) {
+			_resources[i].texture->bind_memory(_blocks.back(), 0);
+		}
+	}
+}
+
+void FrameGraph::execute(const vk::CommandBuffer& cmd, GpuTimer* timer) {
+	//What happened to each resource so far this frame
+	struct State {
+		vk::PipelineStageFlags2 writeStages;
+		vk::AccessFlags2 writeAccess;
+		// Stages the last write was made visible to
+		vk::PipelineStageFlags2 visibleStages;
+		// Stages that read since the last write
+		vk::PipelineStageFlags2 readStages;
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+		bool touched = false;
+	};
+	std::vector<State> states(_resources.size());
+	//Barriers reach back to earlier submissions on the queue, so the previous frames' accesses are waited on like writes of this one
+	for(uint32_t i = 0; i < _resources.size(); i++) {
+		states[i].writeStages = _resources[i].previousStages;
+		states[i].writeAccess = _resources[i].previousAccess;
+	}
+
+	//Everything that used a memory block so far, an image placed in it waits for that before its first use
+	std::vector<vk::PipelineStageFlags2> blockStages(_blocks.size());
+	std::vector<vk::AccessFlags2> blockAccess(_blocks.size());
+
+	_barrier_batches = 0;
+	std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+
+	auto flush = [this, &cmd, &imageBarriers](const vk::MemoryBarrier2& memoryBarrier) {
+		if (imageBarriers.empty() && !memoryBarrier.dstStageMask) {
+			return;
+		}
+
+		vk::DependencyInfo dependency;
+		dependency.setImageMemoryBarriers(imageBarriers);
+		if (memoryBarrier.dstStageMask) {
+			dependency.setMemoryBarriers(memoryBarrier);
+		}
+
+		cmd.pipelineBarrier2(dependency);
+		_barrier_batches++;
+		imageBarriers.clear();
+	};
+
+	for(const auto& pass : _passes) {
+		if (pass.culled) {
+			continue;
+		}
+
+		//Buffer hazards of the pass are merged into a single global barrier
+		vk::MemoryBarrier2 memoryBarrier;
+		for(const auto& a : pass.accesses) {
+			const auto& r = _resources[a.resource];
+			auto& s = states[a.resource];
+			bool write = static_cast<bool>(a.access & FRAME_GRAPH_WRITE_ACCESS);
+
+			auto srcStages = s.writeStages;
+			auto srcAccess = s.writeAccess;
+			if (r.transient && !s.touched) {
+				srcStages |= blockStages[r.block];
+				srcAccess |= blockAccess[r.block];
+			}
+
+			bool transition = r.image && (a.discard || s.layout != a.layout);
+			bool hazard = write ? (srcStages || s.readStages) : (srcStages && (s.visibleStages & a.stages) != a.stages);
+
+			if (transition || hazard) {
+				if (write || transition) {
+					srcStages |= s.readStages;
+				}
+				//Nothing to wait for: depend on the pass's own stages, so the semaphore waits of the submission still cover it
+				if (!srcStages) {
+					srcStages = a.stages;
+				}
+
+				if (r.image) {
+					imageBarriers.emplace_back(srcStages, srcAccess, a.stages, a.access, a.discard ? vk::ImageLayout::eUndefined : s.layout, a.layout,
+											   VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, r.handle,
+											   vk::ImageSubresourceRange(r.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, 1));
+				} else {
+					memoryBarrier.srcStageMask |= srcStages;
+					memoryBarrier.srcAccessMask |= srcAccess;
+					memoryBarrier.dstStageMask |= a.stages;
+					memoryBarrier.dstAccessMask |= a.access;
+				}
+			}
+
+			if (write) {
+				s.writeStages = a.stages;
+				s.writeAccess = a.access & FRAME_GRAPH_WRITE_ACCESS;
+				s.visibleStages = {};
+				s.readStages = {};
+			} else if (transition) {
+				//A layout transition is a write of its own, later readers in other stages wait for it
+				s.writeStages = a.stages;
+				s.writeAccess = {};
+				s.visibleStages = a.stages;
+				s.readStages = a.stages;
+			} else {
+				if (hazard) {
+					s.visibleStages |= a.stages;
+				}
+				s.readStages |= a.stages;
+			}
+
+			if (r.image) {
+				s.layout = a.layout;
+			}
+			s.touched = true;
+
+			if (r.transient) {
+				blockStages[r.block] |= a.stages;
+				blockAccess[r.block] |= a.access & FRAME_GRAPH_WRITE_ACCESS;
+			}
+		}
+		flush(memoryBarrier);
+
+		if (timer) {
+			timer->begin(cmd, pass.name);
+		}
+		pass.record(cmd);
+		if (timer) {
+			timer->end(cmd);
+		}
+	}
+
+	//Imported images end the frame in the layout their owner expects, nothing in this submission waits for that
+	for(uint32_t i = 0; i < _resources.size(); i++) {
+		const auto& r = _resources[i];
+		const auto& s = states[i];
+		if (!r.image || r.transient || !s.touched || r.finalLayout == vk::ImageLayout::eUndefined || s.layout == r.finalLayout) {
+			continue;
+		}
+
+		imageBarriers.emplace_back(s.writeStages | s.readStages, s.writeAccess, vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+								   s.layout, r.finalLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, r.handle,
+								   vk::ImageSubresourceRange(r.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, 1));
+	}
+	flush(vk::MemoryBarrier2());
+
+	_passes.clear();
+}
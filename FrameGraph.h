@@ -0,0 +1,135 @@
+#ifndef VKOCCLUSIONTEST_FRAMEGRAPH_H
+#define VKOCCLUSIONTEST_FRAMEGRAPH_H
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include "Instance.h"
+#include "Texture.h"
+#include "GpuTimer.h"
+
+// Index of a resource declared on a FrameGraph
+using FrameGraphResource = uint32_t;
+
+struct FrameGraphImageDesc {
+	vk::Format format;
+	vk::ImageUsageFlags usage;
+	glm::ivec2 size;
+	uint32_t levels = 1;
+
+	bool operator==(const FrameGraphImageDesc&) const = default;
+};
+
+struct FrameGraphAccess {
+	FrameGraphResource resource;
+	vk::PipelineStageFlags2 stages;
+	vk::AccessFlags2 access;
+	// Layout the pass uses an image in, ignored for buffers
+	vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	// The pass overwrites the whole resource, its previous contents are dropped
+	bool discard = false;
+};
+
+// Passes declare what they read and write, barriers are derived from that and batched into one call per pass.
+// Images are always synchronized with all of their levels.
+// Resources are declared once and persist, passes are declared again every frame before compile() and execute().
+// Transient images only live between their first and last use within a frame, the ones that never overlap share memory
+class FrameGraph {
+private:
+	struct Resource {
+		std::string_view name;
+		bool image;
+		bool transient;
+		FrameGraphImageDesc desc;
+		vk::ImageAspectFlags aspect;
+		vk::ImageLayout finalLayout;
+		// Access of earlier submissions the first use in a frame waits for
+		vk::PipelineStageFlags2 previousStages;
+		vk::AccessFlags2 previousAccess;
+		vk::Image handle;
+		std::unique_ptr<Texture> texture;
+		// Kept passes between the first and last use of the last compile, and the memory block it was placed in
+		uint32_t firstPass;
+		uint32_t lastPass;
+		uint32_t block;
+	};
+
+	struct Pass {
+		std::string_view name;
+		std::vector<FrameGraphAccess> accesses;
+		std::function<void(const vk::CommandBuffer&)> record;
+		bool sideEffects;
+		bool culled;
+	};
+
+	std::shared_ptr<Instance> instance;
+	std::vector<Resource> _resources;
+	std::vector<Pass> _passes;
+	std::vector<vk::DeviceMemory> _blocks;
+	// Descriptions and lifetimes of the transient images the current blocks were planned for
+	std::vector<std::tuple<FrameGraphImageDesc, uint32_t, uint32_t>> _plan;
+	vk::DeviceSize _transient_bytes;
+	vk::DeviceSize _allocated_bytes;
+	bool _planned;
+	uint32_t _culled_passes;
+	uint32_t _barrier_batches;
+
+	void cull();
+	void allocate();
+	void release();
+public:
+	explicit FrameGraph(std::shared_ptr<Instance> instance);
+
+	FrameGraph(const FrameGraph&) = delete;
+	FrameGraph(FrameGraph&&) = delete;
+	~FrameGraph();
+
+	// Image created and owned by the graph, recreated by compile() when 'desc' changes
+	FrameGraphResource create_image(std::string_view name, const FrameGraphImageDesc& desc, vk::ImageAspectFlags aspect);
+	// Image owned elsewhere, set_image() has to provide it every frame. It is left in 'finalLayout' at the end of the frame
+	FrameGraphResource import_image(std::string_view name, vk::ImageAspectFlags aspect, vk::ImageLayout finalLayout);
+	// Buffers are synchronized as a whole, with global memory barriers.
+	// Buffers carried from frame to frame pass how the previous frames last accessed them
+	FrameGraphResource import_buffer(std::string_view name, vk::PipelineStageFlags2 previousStages = {}, vk::AccessFlags2 previousAccess = {});
+
+	void set_image(FrameGraphResource resource, const vk::Image& image);
+	void set_desc(FrameGraphResource resource, const FrameGraphImageDesc& desc);
+
+	// 'name' must outlive the graph, it is also the GPU timer region of the pass.
+	// Passes without side effects are culled when nothing reads what they write
+	void add_pass(std::string_view name, std::vector<FrameGraphAccess> accesses, std::function<void(const vk::CommandBuffer&)> record, bool sideEffects = false);
+
+	// Culls passes and places transient images, returns true if they were recreated (views of them have to be recreated too)
+	bool compile();
+	// Records the kept passes with their barriers, then forgets them
+	void execute(const vk::CommandBuffer& cmd, GpuTimer* timer = nullptr);
+
+	// Only valid for transient images used by a kept pass, after compile()
+	inline const Texture& texture(FrameGraphResource resource) const {
+		return *_resources[resource].texture;
+	}
+
+	// Memory transient images would need without aliasing
+	inline vk::DeviceSize transient_bytes() const {
+		return _transient_bytes;
+	}
+
+	inline vk::DeviceSize allocated_bytes() const {
+		return _allocated_bytes;
+	}
+
+	inline uint32_t culled_passes() const {
+		return _culled_passes;
+	}
+
+	// pipelineBarrier2 calls of the last execute
+	inline uint32_t barrier_batches() const {
+		return _barrier_batches;
+	}
+};
+
+#endif //VKOCCLUSIONTEST_FRAMEGRAPH_H
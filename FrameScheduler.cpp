@@ -0,0 +1,299 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+FrameScheduler::FrameScheduler(std::shared_ptr<Instance> inst, const FrameSchedulerSettings& settings, const Swapchain& swapchain,
+							   PipelineCollection& pipelines, const vk::Sampler& downsampleSampler, size_t maxObjects) :
+							   instance(std::move(inst)), _settings(settings), _frame_number(0), _completed_frames(0),
+							   _stats_frames(0), _stats_gpu_latency(0.0), _stats_gpu_latency_samples(0),
+							   _stats_present_latency(0.0), _stats_present_latency_max(0.0), _stats_present_latency_samples(0),
+							   _stats_gpu_samples(0), _stats_queried_objects(0), _stats_visible_objects(0), _stats_reused_objects(0), _stats_stale_objects(0),
+							   _stats_tested_nodes(0), _stats_candidate_objects(0), _stats_hzb_size(0), _stats_hzb_reduction(false), _stats_bvh_nodes(0), _stats_bvh_levels(0),
+							   _stats_upload_bytes(0), _stats_record_time(0.0), _stats_barrier_batches(0) {
+	_settings.framesInFlight = std::max(_settings.framesInFlight, 1U);
+	_settings.maxCpuAhead = std::clamp(_settings.maxCpuAhead, 1U, _settings.framesInFlight);
+	_settings.frame.secondaryViews = std::min(_settings.frame.secondaryViews, FRAME_MAX_VIEWS - 1U);
+	_settings.frame.compactDraws = _settings.frame.compactDraws && instance->draw_indirect_count_supported();
+
+	if (_settings.recordThreads > 0) {
+		_record_pool = std::make_unique<ThreadPool>(_settings.recordThreads);
+	}
+
+	if (_settings.visibility.enabled) {
+		_visibility = std::make_shared<VisibilityCache>(instance, _settings.visibility, maxObjects);
+	}
+
+	for(uint32_t i = 0; i < _settings.framesInFlight; i++) {
+		_frames.push_back(std::make_unique<FrameData>(instance, i, swapchain, pipelines, downsampleSampler, _settings.frame, _visibility));
+		_image_available_semaphores.push_back(instance->device().createSemaphore({}));
+	}
+
+	_latch_times.resize(_settings.framesInFlight);
+	_pending.resize(_settings.framesInFlight, false);
+	_submitted_frames.resize(_settings.framesInFlight, 0);
+
+	update_present_semaphores(swapchain);
+
+	_stats_start = Clock::now();
+}
+
+FrameScheduler::~FrameScheduler() {
+	instance->wait_idle();
+	_deletion_queue.flush_all();
+
+	for(auto& s : _image_available_semaphores) {
+		instance->device().destroySemaphore(s);
+	}
+	_image_available_semaphores.clear();
+
+	for(auto& s : _render_finished_semaphores) {
+		instance->device().destroySemaphore(s);
+	}
+	_render_finished_semaphores.clear();
+
+	_frames.clear();
+	_visibility.reset();
+}
+
+void FrameScheduler::update_present_semaphores(const Swapchain& swapchain) {
+	//Presentation waits on a semaphore per swapchain image, a slot may be reused before its image is done presenting
+	if (_render_finished_semaphores.size() == swapchain.images().size()) {
+		return;
+	}
+
+	//Pending presents of the old swapchain may still wait on the old ones
+	_deletion_queue.push([device = instance->device(), semaphores = std::move(_render_finished_semaphores)]() {
+		for(auto& s : semaphores) {
+			device.destroySemaphore(s);
+		}
+	});
+
+	_render_finished_semaphores.clear();
+	_render_finished_semaphores.resize(swapchain.images().size());
+	for(auto& s : _render_finished_semaphores) {
+		s = instance->device().createSemaphore({});
+	}
+}
+
+void FrameScheduler::wait_for_slot(uint32_t slot) {
+	const auto& frame = _frames[slot];
+	instance->device().waitForFences({ frame->in_flight_fence() }, true, UINT64_MAX);
+
+	if (_pending[slot]) {
+		_pending[slot] = false;
+		_completed_frames = std::max(_completed_frames, _submitted_frames[slot] + 1);
+		_stats_gpu_latency += std::chrono::duration<double, std::milli>(Clock::now() - _latch_times[slot]).count();
+		_stats_gpu_latency_samples++;
+
+		collect_gpu_timings(*frame);
+	}
+}
+
+void FrameScheduler::collect_gpu_timings(const FrameData& frame) {
+	if (frame.gpu_timer() == nullptr || frame.queried_objects() == 0) {
+		return;
+	}
+
+	auto results = frame.gpu_timer()->results();
+	if (results.empty()) {
+		return;
+	}
+
+	for(const auto& r : results) {
+		auto it = std::find_if(_stats_gpu_passes.begin(), _stats_gpu_passes.end(), [&r](const auto& p) { return p.first == r.name; });
+		if (it == _stats_gpu_passes.end()) {
+			_stats_gpu_passes.emplace_back(r.name, r.milliseconds);
+		} else {
+			it->second += r.milliseconds;
+		}
+	}
+
+	_stats_gpu_samples++;
+	_stats_queried_objects += frame.queried_objects();
+	_stats_visible_objects += frame.visible_objects();
+	_stats_reused_objects += frame.reused_objects();
+	_stats_stale_objects += frame.stale_objects();
+	_stats_tested_nodes += frame.tested_nodes();
+	_stats_candidate_objects += frame.candidate_objects();
+	_stats_bvh_nodes = frame.hierarchy_nodes();
+	_stats_bvh_levels = frame.hierarchy_levels();
+	if (frame.hz_buffer()) {
+		_stats_hzb_size = frame.hz_buffer()->sizes()[0];
+		_stats_hzb_reduction = frame.hzb_reduction();
+	}
+}
+
+void FrameScheduler::poll_presents() {
+	//Presents complete in order, stop at the first one that is not on screen yet
+	while(!_pending_presents.empty()) {
+		const auto& present = _pending_presents.front();
+		auto result = instance->device().waitForPresentKHR(present.swapchain, present.presentId, 0);
+		if (result == vk::Result::eTimeout) {
+			break;
+		}
+
+		auto latency = std::chrono::duration<double, std::milli>(Clock::now() - present.latchTime).count();
+		_stats_present_latency += latency;
+		_stats_present_latency_max = std::max(_stats_present_latency_max, latency);
+		_stats_present_latency_samples++;
+
+		_pending_presents.pop_front();
+	}
+}
+
+FrameContext FrameScheduler::begin_frame(const Swapchain& swapchain) {
+	auto device = instance->device();
+	auto slot = static_cast<uint32_t>(_frame_number % _settings.framesInFlight);
+
+	//Ids of an old swapchain can not be waited on anymore
+	if (!_pending_presents.empty() && _pending_presents.back().swapchain != swapchain.swapchain()) {
+		_pending_presents.clear();
+	}
+	poll_presents();
+
+	//Pick up frames the GPU already finished, so their latency is measured as close to completion as possible
+	for(uint32_t i = 0; i < _settings.framesInFlight; i++) {
+		if (_pending[i] && device.getFenceStatus(_frames[i]->in_flight_fence()) == vk::Result::eSuccess) {
+			wait_for_slot(i);
+		}
+	}
+
+	//Limit how many submitted frames the CPU can be ahead of the GPU
+	if (_frame_number >= _settings.maxCpuAhead) {
+		wait_for_slot(static_cast<uint32_t>((_frame_number - _settings.maxCpuAhead) % _settings.framesInFlight));
+	}
+	wait_for_slot(slot);
+
+	_deletion_queue.flush(_completed_frames);
+	update_present_semaphores(swapchain);
+
+	auto imageIndex = device.acquireNextImageKHR(swapchain.swapchain(), UINT64_MAX, _image_available_semaphores[slot], nullptr).value;
+
+	return { *_frames[slot], _frame_number, imageIndex, swapchain.images()[imageIndex], swapchain.image_views()[imageIndex] };
+}
+
+void FrameScheduler::end_frame(const Swapchain& swapchain, const FrameContext& context, Clock::time_point latchTime) {
+	auto slot = static_cast<uint32_t>(context.frameNumber % _settings.framesInFlight);
+	const auto& frame = context.frame;
+
+	instance->device().resetFences({ frame.in_flight_fence() });
+
+	vk::PipelineStageFlags waitFlags = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer;
+	instance->graphics_queue().submit(
+			{{ _image_available_semaphores[slot], waitFlags, frame.command_buffer(), _render_finished_semaphores[context.imageIndex] }}, frame.in_flight_fence());
+	_pending[slot] = true;
+	_latch_times[slot] = latchTime;
+	_submitted_frames[slot] = context.frameNumber;
+
+	vk::PresentInfoKHR presentInfo(_render_finished_semaphores[context.imageIndex], swapchain.swapchain(), context.imageIndex);
+
+	//Present ids must increase per swapchain, the frame number always does
+	auto presentId = context.frameNumber + 1;
+	vk::PresentIdKHR presentIdInfo(presentId);
+	if (instance->present_wait_supported()) {
+		presentInfo.setPNext(&presentIdInfo);
+		_pending_presents.push_back({ presentId, swapchain.swapchain(), latchTime });
+	}
+
+	instance->present_queue().presentKHR(presentInfo);
+
+	_frame_number++;
+	_deletion_queue.set_frame(_frame_number);
+	_stats_frames++;
+	_stats_upload_bytes += frame.uploaded_bytes();
+	_stats_record_time += frame.record_milliseconds();
+	_stats_barrier_batches = frame.frame_graph().barrier_batches();
+	report_stats();
+}
+
+void FrameScheduler::report_stats() {
+	auto elapsed = std::chrono::duration<double>(Clock::now() - _stats_start).count();
+	if (elapsed < 1.0) {
+		return;
+	}
+
+	std::cout << "[Frames] " << _settings.framesInFlight << " in flight, " << _settings.maxCpuAhead << " ahead: "
+			  << (_stats_frames / elapsed) << " fps, latch to GPU done "
+			  << (_stats_gpu_latency_samples > 0 ? _stats_gpu_latency / _stats_gpu_latency_samples : 0.0) << "ms";
+	if (_stats_present_latency_samples > 0) {
+		std::cout << ", latch to present " << (_stats_present_latency / _stats_present_latency_samples) << "ms (max "
+				  << _stats_present_latency_max << "ms)";
+	}
+	std::cout << ", uploaded " << (_stats_frames > 0 ? _stats_upload_bytes / 1024.0 / _stats_frames : 0.0) << " KiB per frame" << std::endl;
+
+	//Compare runs with different --record-threads to see how recording scales
+	std::cout << "[Record] " << (_stats_frames > 0 ? _stats_record_time / _stats_frames : 0.0) << "ms per frame on "
+			  << (_record_pool ? std::to_string(_record_pool->size()) + " threads" : std::string("the main thread")) << std::endl;
+
+	if (_stats_gpu_samples > 0) {
+		std::cout << "[GPU] " << (_settings.frame.sceneBufferPlacement == BufferPlacement::eDeviceLocal ? "device local" : "host visible") << " scene buffers, "
+				  << (_settings.frame.compactDraws ? "compacted" : "all") << " draws, " << (_settings.frame.secondaryViews + 1) << " views, "
+				  << (_settings.frame.directPresent ? "direct" : "resolved") << " present:";
+		double queryTime = 0.0;
+		double hzbTime = 0.0;
+		for(const auto& [name, total] : _stats_gpu_passes) {
+			std::cout << " " << name << " " << (total / _stats_gpu_samples) << "ms";
+			if (name == TUNED_KERNEL_QUERY) {
+				queryTime = total;
+			}
+			if (name == "z pass" || name == TUNED_KERNEL_COPY || name == TUNED_KERNEL_DOWNSAMPLE) {
+				hzbTime += total;
+			}
+		}
+		if (queryTime > 0.0) {
+			std::cout << ", culling " << (_stats_queried_objects / (queryTime * 1000.0)) << " instances/us";
+		}
+		std::cout << ", " << _stats_barrier_batches << " barrier batches" << std::endl;
+
+		//What the HZB costs to build against what it culls, run with different --hzb-* policies to pick one
+		auto culled = _stats_queried_objects > 0 ? 1.0 - static_cast<double>(_stats_visible_objects) / _stats_queried_objects : 0.0;
+		std::cout << "[HZB] " << _stats_hzb_size.x << "x" << _stats_hzb_size.y << " ("
+				  << (HZBPolicy::memory_bytes(_stats_hzb_size) / (1024.0 * 1024.0)) << " MiB, "
+				  << (_stats_hzb_reduction ? "max reduction sampler" : "plain loads") << "): built in " << (hzbTime / _stats_gpu_samples)
+				  << "ms, culled " << (culled * 100.0) << "% of " << (_stats_queried_objects / _stats_gpu_samples) << " instances" << std::endl;
+
+		if (_visibility) {
+			auto reused = _stats_queried_objects > 0 ? static_cast<double>(_stats_reused_objects) / _stats_queried_objects : 0.0;
+			std::cout << "[Visibility] reused " << (reused * 100.0) << "% of main view tests (agree " << _visibility->settings().agreeFrames
+					  << ", refresh every " << _visibility->settings().refreshPeriod << ")";
+			if (_visibility->settings().validate) {
+				std::cout << ", " << (_stats_stale_objects / _stats_gpu_samples) << " reused results hid a visible instance";
+			}
+			std::cout << std::endl;
+		}
+
+		if (!_texture_label.empty()) {
+			auto it = std::find_if(_stats_gpu_passes.begin(), _stats_gpu_passes.end(), [](const auto& p) { return p.first == "draw"; });
+			std::cout << "[Textures] " << _texture_label << ": draw pass " << (it != _stats_gpu_passes.end() ? it->second / _stats_gpu_samples : 0.0)
+					  << "ms" << std::endl;
+		}
+
+		//Run with --no-bvh on the same scene to compare against testing every instance
+		if (_settings.frame.hierarchicalCulling) {
+			auto it = std::find_if(_stats_gpu_passes.begin(), _stats_gpu_passes.end(), [](const auto& p) { return p.first == "bvh"; });
+			auto reached = _stats_queried_objects > 0 ? static_cast<double>(_stats_candidate_objects) / _stats_queried_objects : 0.0;
+			std::cout << "[BVH] " << _stats_bvh_nodes << " nodes in " << _stats_bvh_levels << " levels: tested " << (_stats_tested_nodes / _stats_gpu_samples)
+					  << " nodes in " << (it != _stats_gpu_passes.end() ? it->second / _stats_gpu_samples : 0.0) << "ms, "
+					  << (reached * 100.0) << "% of instances reached the query" << std::endl;
+		}
+	}
+
+	_stats_start = Clock::now();
+	_stats_frames = 0;
+	_stats_gpu_latency = 0.0;
+	_stats_gpu_latency_samples = 0;
+	_stats_present_latency = 0.0;
+	_stats_present_latency_max = 0.0;
+	_stats_present_latency_samples = 0;
+	_stats_gpu_passes.clear();
+	_stats_gpu_samples = 0;
+	_stats_queried_objects = 0;
+	_stats_visible_objects = 0;
+	_stats_reused_objects = 0;
+	_stats_stale_objects = 0;
+	_stats_tested_nodes = 0;
+	_stats_candidate_objects = 0;
+	_stats_upload_bytes = 0;
+	_stats_record_time = 0.0;
+}
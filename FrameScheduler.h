@@ -0,0 +1,139 @@
+#ifndef VKOCCLUSIONTEST_FRAMESCHEDULER_H
+#define VKOCCLUSIONTEST_FRAMESCHEDULER_H
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <string_view>
+#include "Instance.h"
+#include "Swapchain.h"
+#include "FrameData.h"
+#include "PipelineCollection.h"
+#include "ThreadPool.h"
+#include "DeletionQueue.h"
+
+struct FrameSchedulerSettings {
+	// Amount of FrameData slots, independent of the amount of swapchain images
+	uint32_t framesInFlight = 2;
+	// How many submitted frames the CPU may run ahead of the GPU, at most framesInFlight
+	uint32_t maxCpuAhead = 2;
+	// Threads recording the passes of a frame in parallel, 0 records them on the thread calling FrameData::draw
+	uint32_t recordThreads = 0;
+	// Passed on to every FrameData
+	FrameSettings frame;
+	// Main view visibility reused across frames, shared by all slots
+	VisibilityCacheSettings visibility;
+};
+
+// Frame that is currently being recorded
+struct FrameContext {
+	FrameData& frame;
+	uint64_t frameNumber;
+	uint32_t imageIndex;
+	vk::Image image;
+	vk::ImageView view;
+};
+
+class FrameScheduler {
+private:
+	using Clock = std::chrono::steady_clock;
+
+	std::shared_ptr<Instance> instance;
+	FrameSchedulerSettings _settings;
+	std::unique_ptr<ThreadPool> _record_pool;
+	std::shared_ptr<VisibilityCache> _visibility;
+	std::vector<std::unique_ptr<FrameData>> _frames;
+	std::vector<vk::Semaphore> _image_available_semaphores;
+	std::vector<vk::Semaphore> _render_finished_semaphores;
+	std::vector<Clock::time_point> _latch_times;
+	std::vector<bool> _pending;
+	// Frame number each slot last submitted
+	std::vector<uint64_t> _submitted_frames;
+	uint64_t _frame_number;
+	// Frames known to be done on the GPU, they complete in submission order
+	uint64_t _completed_frames;
+	DeletionQueue _deletion_queue;
+
+	struct PendingPresent {
+		uint64_t presentId;
+		vk::SwapchainKHR swapchain;
+		Clock::time_point latchTime;
+	};
+	std::deque<PendingPresent> _pending_presents;
+
+	Clock::time_point _stats_start;
+	uint32_t _stats_frames;
+	double _stats_gpu_latency;
+	uint32_t _stats_gpu_latency_samples;
+	double _stats_present_latency;
+	double _stats_present_latency_max;
+	uint32_t _stats_present_latency_samples;
+	std::vector<std::pair<std::string_view, double>> _stats_gpu_passes;
+	uint32_t _stats_gpu_samples;
+	uint64_t _stats_queried_objects;
+	uint64_t _stats_visible_objects;
+	uint64_t _stats_reused_objects;
+	uint64_t _stats_stale_objects;
+	uint64_t _stats_tested_nodes;
+	uint64_t _stats_candidate_objects;
+	// Of the last collected frame
+	glm::ivec2 _stats_hzb_size;
+	bool _stats_hzb_reduction;
+	uint32_t _stats_bvh_nodes;
+	uint32_t _stats_bvh_levels;
+	uint64_t _stats_upload_bytes;
+	double _stats_record_time;
+	// Of the last recorded frame
+	uint32_t _stats_barrier_batches;
+	// Material texture the draw pass time is reported for, empty when none is compared
+	std::string _texture_label;
+
+	void collect_gpu_timings(const FrameData& frame);
+
+	void wait_for_slot(uint32_t slot);
+	void poll_presents();
+	void update_present_semaphores(const Swapchain& swapchain);
+	void report_stats();
+public:
+	FrameScheduler(std::shared_ptr<Instance> instance, const FrameSchedulerSettings& settings, const Swapchain& swapchain,
+				   PipelineCollection& pipelines, const vk::Sampler& downsampleSampler, size_t maxObjects);
+
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler(FrameScheduler&&) = delete;
+	~FrameScheduler();
+
+	// Waits for a free slot and acquires the next swapchain image
+	FrameContext begin_frame(const Swapchain& swapchain);
+	// Submits the frame's command buffer and presents the acquired image.
+	// 'latchTime' is when the input used for this frame was sampled, latency is measured from there
+	void end_frame(const Swapchain& swapchain, const FrameContext& context, Clock::time_point latchTime);
+
+	// Once set, the draw pass time is also reported on a [Textures] line with 'label', to compare the sampling
+	// cost of the same material texture in different formats across runs
+	inline void set_texture_label(std::string label) {
+		_texture_label = std::move(label);
+	}
+
+	inline const FrameSchedulerSettings& settings() const {
+		return _settings;
+	}
+
+	// Pool to pass to FrameData::draw, null when recording on the calling thread
+	inline ThreadPool* record_pool() const {
+		return _record_pool.get();
+	}
+
+	inline uint64_t frame_number() const {
+		return _frame_number;
+	}
+
+	// Objects frames in flight may still use, such as a replaced swapchain
+	inline DeletionQueue& deletion_queue() {
+		return _deletion_queue;
+	}
+};
+
+#endif //VKOCCLUSIONTEST_FRAMESCHEDULER_H
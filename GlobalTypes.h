@@ -2,6 +2,7 @@
 #define VKOCCLUSIONTEST_GLOBALTYPES_H
 
 #include <glm/glm.hpp>
+#include <cstdint>
 #define align_16 alignas(16)
 
 #define v3 glm::vec3
@@ -15,11 +16,111 @@
 inline Vertex makeVertex(glm::vec3 position = {}, glm::vec3 normal = {}, glm::vec3 tangent = {}, glm::vec4 uv = {}, glm::vec4 boneWeights = {}, glm::ivec4 boneIds = {}, glm::vec4 vertexColor = {}) {
 	return Vertex(position, normal, tangent, uv, boneWeights, boneIds, vertexColor);
 }
-inline ObjectInstance makeInstance(glm::mat4 model = glm::mat4(1.0), int materialId = 0) {
-	return ObjectInstance(model, glm::ivec4(materialId));
+// Stores the affine part of 'model' as the three rows ObjectInstance keeps
+inline void setInstanceModel(ObjectInstance& instance, const glm::mat4& model) {
+	for(int row = 0; row < 3; row++) {
+		instance.model[row] = glm::vec4(model[0][row], model[1][row], model[2][row], model[3][row]);
+	}
+}
+
+inline ObjectInstance makeInstance(glm::mat4 model = glm::mat4(1.0), uint32_t meshId = 0, uint32_t materialId = 0, uint32_t batchId = 0) {
+	ObjectInstance instance {};
+	setInstanceModel(instance, model);
+	instance.meshId = meshId;
+	instance.materialId = materialId;
+	instance.batchId = batchId;
+	return instance;
+}
+
+inline ViewData makeView(glm::mat4 view, glm::mat4 projection, uint32_t flags = VIEW_FLAG_NONE) {
+	ViewData data {};
+	data.view = view;
+	data.projection = projection;
+	data.flags = flags;
+	return data;
 }
 
 #undef uint
+
+// Push constant blocks, these mirror the ones declared in the shaders.
+// Storage buffers are passed by device address (see shaders/libs/references.glsl)
+struct ZPassConstants {
+	uint64_t vertices;
+	uint64_t instances;
+};
+
+struct DrawConstants {
+	uint64_t vertices;
+	uint64_t visibleInstances;
+	uint64_t materials;
+	uint32_t materialCount;
+	uint32_t padding;
+};
+
+struct QueryConstants {
+	uint64_t instances;
+	uint64_t indirections;
+	uint64_t commands;
+	uint64_t visibleInstances;
+	uint64_t meshes;
+	uint64_t views;
+	uint64_t counts;
+	uint64_t history;
+	uint64_t candidates;
+	uint32_t objectsAmount;
+	uint32_t batchesAmount;
+	uint32_t viewsAmount;
+	// Entry of 'counts' visible instances of the main view are counted into, reused and stale results follow it
+	uint32_t visibleCount;
+	uint32_t frameIndex;
+	uint32_t historyFlags;
+	// Results that have to agree before they are reused, and how often reused ones are tested anyway
+	uint32_t historyAgree;
+	uint32_t historyPeriod;
+	// World space distance an instance's bounds may move before its history starts over
+	float historyThreshold;
+	// Dispatched over the candidates of the hierarchy traversal instead of every instance
+	uint32_t fromCandidates;
+};
+
+struct BVHConstants {
+	uint64_t nodes;
+	uint64_t leaves;
+	uint64_t queue;
+	uint64_t lists;
+	uint64_t candidates;
+	uint64_t views;
+	uint64_t counts;
+	uint32_t level;
+	// Where this level's nodes and the next level's nodes start in 'queue'
+	uint32_t levelFirst;
+	uint32_t nextFirst;
+	uint32_t viewsAmount;
+	uint32_t queryGroupSize;
+	uint32_t testedCount;
+};
+
+struct CommandsConstants {
+	uint64_t batches;
+	uint64_t meshes;
+	uint64_t drawCommands;
+	uint64_t clearCommands;
+	uint64_t counts;
+	uint32_t batchesAmount;
+	uint32_t compact;
+	uint32_t instancesAmount;
+	uint32_t viewsAmount;
+};
+
+struct CompactConstants {
+	uint64_t sourceCommands;
+	uint64_t targetCommands;
+	uint64_t counts;
+	uint32_t batchesAmount;
+	uint32_t countIndex;
+	uint32_t viewsAmount;
+	uint32_t padding;
+};
 #undef v3
 #undef v4
 #undef i4
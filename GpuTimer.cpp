@@ -0,0 +1,64 @@
+#include "GpuTimer.h"
+#include <stdexcept>
+
+GpuTimer::GpuTimer(std::shared_ptr<Instance> inst, uint32_t maxRegions) : instance(std::move(inst)), _max_regions(maxRegions), _open(false) {
+	_pool = instance->device().createQueryPool({ {}, vk::QueryType::eTimestamp, maxRegions * 2 });
+}
+
+GpuTimer::~GpuTimer() {
+	if (_pool) {
+		instance->device().destroyQueryPool(_pool);
+	}
+}
+
+void GpuTimer::reset(const vk::CommandBuffer& cmd) {
+	cmd.resetQueryPool(_pool, 0, _max_regions * 2);
+	_regions.clear();
+	_open = false;
+}
+
+void GpuTimer::begin(const vk::CommandBuffer& cmd, std::string_view name) {
+	if (_open) {
+		throw std::runtime_error("GpuTimer regions can not be nested");
+	}
+
+	if (_regions.size() >= _max_regions) {
+		throw std::runtime_error("Too many GpuTimer regions");
+	}
+
+	cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, _pool, _regions.size() * 2);
+	_regions.push_back(name);
+	_open = true;
+}
+
+void GpuTimer::end(const vk::CommandBuffer& cmd) {
+	if (!_open) {
+		throw std::runtime_error("GpuTimer::end without a matching begin");
+	}
+
+	cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, _pool, _regions.size() * 2 - 1);
+	_open = false;
+}
+
+std::vector<GpuTimerResult> GpuTimer::results() const {
+	std::vector<GpuTimerResult> results;
+	if (_regions.empty() || _open) {
+		return results;
+	}
+
+	auto count = static_cast<uint32_t>(_regions.size() * 2);
+	std::vector<uint64_t> timestamps(count);
+	auto result = instance->device().getQueryPoolResults(_pool, 0, count, timestamps.size() * sizeof(uint64_t), timestamps.data(),
+														 sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+	if (result != vk::Result::eSuccess) {
+		return results;
+	}
+
+	auto mask = instance->timestamp_mask();
+	for(size_t i = 0; i < _regions.size(); i++) {
+		auto ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & mask;
+		results.push_back({ _regions[i], ticks * instance->timestamp_period() / 1000000.0 });
+	}
+
+	return results;
+}
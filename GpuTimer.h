@@ -0,0 +1,40 @@
+#ifndef VKOCCLUSIONTEST_GPUTIMER_H
+#define VKOCCLUSIONTEST_GPUTIMER_H
+
+#include <vulkan/vulkan.hpp>
+#include <memory>
+#include <vector>
+#include <string_view>
+#include "Instance.h"
+
+struct GpuTimerResult {
+	std::string_view name;
+	double milliseconds;
+};
+
+// Timestamp query pool measuring named regions of a single command buffer
+class GpuTimer {
+private:
+	std::shared_ptr<Instance> instance;
+	vk::QueryPool _pool;
+	uint32_t _max_regions;
+	std::vector<std::string_view> _regions;
+	bool _open;
+public:
+	GpuTimer(std::shared_ptr<Instance> instance, uint32_t maxRegions);
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer(GpuTimer&&) = delete;
+	~GpuTimer();
+
+	// Must be recorded outside of a render pass, before any region of this command buffer
+	void reset(const vk::CommandBuffer& cmd);
+	// 'name' must outlive the results, string literals are expected
+	void begin(const vk::CommandBuffer& cmd, std::string_view name);
+	void end(const vk::CommandBuffer& cmd);
+
+	// Reads back the regions of the last submission, call only once its fence has signaled
+	std::vector<GpuTimerResult> results() const;
+};
+
+#endif //VKOCCLUSIONTEST_GPUTIMER_H
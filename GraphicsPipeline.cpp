@@ -1,14 +1,16 @@
 #include "GraphicsPipeline.h"
 #include "Utils.h"
 
-GraphicsPipeline::GraphicsPipeline(std::shared_ptr<Instance> _instance, const std::filesystem::path& vsPath, const std::filesystem::path& fsPath,
-								   const std::vector<std::vector<vk::DescriptorSetLayoutBinding>>& bindings, const std::vector<vk::SubpassDependency>& dependencies,
-								   const std::vector<GraphicsPipelineAttachment>& colorAttachmentFormats, const std::optional<GraphicsPipelineAttachment>& depthFormat)
-								   : instance(std::move(_instance)) {
+GraphicsPipeline::GraphicsPipeline(std::shared_ptr<Instance> _instance, const vk::PipelineCache& cache, std::span<const uint32_t> vsCode, std::span<const uint32_t> fsCode,
+								   const std::vector<std::vector<vk::DescriptorSetLayoutBinding>>& bindings,
+								   const std::vector<vk::Format>& colorFormats, const std::optional<vk::Format>& depthFormat,
+								   const std::vector<vk::PushConstantRange>& pushConstants,
+								   const std::vector<vk::DescriptorSetLayout>& sharedLayouts)
+								   : instance(std::move(_instance)), _color_formats(colorFormats), _depth_format(depthFormat.value_or(vk::Format::eUndefined)) {
 
 	auto device = instance->device();
-	auto vsModule = createShaderModule(vsPath, device);
-	auto fsModule = createShaderModule(fsPath, device);
+	auto vsModule = createShaderModule(vsCode, device);
+	auto fsModule = createShaderModule(fsCode, device);
 
 	std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages = {
 			vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vsModule, "main" ),
@@ -26,37 +28,15 @@ GraphicsPipeline::GraphicsPipeline(std::shared_ptr<Instance> _instance, const st
 		_descriptor_set_layouts.push_back(_descriptor_set_layout);
 	}
 
-	_pipeline_layout = device.createPipelineLayout({ {}, _descriptor_set_layouts });
+	//Sets other passes or owners use too, like the bindless material textures, come after the pipeline's own
+	_owned_layouts = _descriptor_set_layouts.size();
+	_descriptor_set_layouts.insert(_descriptor_set_layouts.end(), sharedLayouts.begin(), sharedLayouts.end());
 
+	_pipeline_layout = device.createPipelineLayout({ {}, _descriptor_set_layouts, pushConstants });
 
-	std::vector<vk::AttachmentDescription> colorAttachments;
-	std::vector<vk::AttachmentReference> colorReferences;
-	uint32_t colorAttachmentId = 0;
-	for(const auto& imageFormat : colorAttachmentFormats) {
-		vk::AttachmentDescription colorAttachment({}, imageFormat.format, vk::SampleCountFlagBits::e1,
-												  vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
-												  vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
-												  imageFormat.startLayout, imageFormat.endLayout);
-		colorAttachments.push_back(colorAttachment);
-		colorReferences.emplace_back(colorAttachmentId, vk::ImageLayout::eColorAttachmentOptimal);
 
-		colorAttachmentId++;
-	}
-
-	vk::AttachmentReference depthReference;
-	if (depthFormat.has_value()) {
-		auto& val = depthFormat.value();
-		vk::AttachmentDescription depthAttachment({}, val.format, vk::SampleCountFlagBits::e1,
-												  vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
-												  vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
-												  val.startLayout, val.endLayout);
-		colorAttachments.push_back(depthAttachment);
-		depthReference = {colorAttachmentId, vk::ImageLayout::eDepthStencilAttachmentOptimal};
-	}
-
-	vk::SubpassDescription subpassDescription( {}, vk::PipelineBindPoint::eGraphics, colorReferences, colorReferences, {}, depthFormat.has_value() ? &depthReference : nullptr);
-	vk::RenderPassCreateInfo renderPassInfo {{}, colorAttachments, subpassDescription, dependencies };
-	_render_pass = device.createRenderPass(renderPassInfo);
+	//Dynamic rendering: attachments are only given by format, images, layouts and load ops are chosen when recording
+	vk::PipelineRenderingCreateInfo renderingInfo(0, _color_formats, _depth_format, vk::Format::eUndefined);
 
 	vk::PipelineVertexInputStateCreateInfo vertexInputInfo( {}, {}, {} );
 	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo( {}, vk::PrimitiveTopology::eTriangleList, false );
@@ -68,15 +48,17 @@ GraphicsPipeline::GraphicsPipeline(std::shared_ptr<Instance> _instance, const st
 	vk::PipelineMultisampleStateCreateInfo msInfo( {}, vk::SampleCountFlagBits::e1, false, 1.0f, nullptr, false, false );
 	vk::PipelineColorBlendAttachmentState blendInfo0(false);
 	blendInfo0.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+	std::vector<vk::PipelineColorBlendAttachmentState> blendAttachments(_color_formats.size(), blendInfo0);
 
-	vk::PipelineColorBlendStateCreateInfo blendInfo( {}, false, vk::LogicOp::eCopy, blendInfo0, { 0.0f, 0.0f, 0.0f, 0.0f });
+	vk::PipelineColorBlendStateCreateInfo blendInfo( {}, false, vk::LogicOp::eCopy, blendAttachments, { 0.0f, 0.0f, 0.0f, 0.0f });
 
 	vk::PipelineDepthStencilStateCreateInfo depthStencilInfo( {}, depthFormat.has_value(), depthFormat.has_value(), vk::CompareOp::eLessOrEqual, false, false);
 
 	vk::GraphicsPipelineCreateInfo pipelineInfo( {}, shaderStages, &vertexInputInfo, &inputAssemblyInfo, nullptr,
-												 &viewportInfo, &rasterizer, &msInfo, &depthStencilInfo, &blendInfo, &dynamicStateInfo, _pipeline_layout, _render_pass);
+												 &viewportInfo, &rasterizer, &msInfo, &depthStencilInfo, &blendInfo, &dynamicStateInfo, _pipeline_layout, nullptr);
+	pipelineInfo.setPNext(&renderingInfo);
 
-	auto res = device.createGraphicsPipeline(nullptr, pipelineInfo);
+	auto res = device.createGraphicsPipeline(cache, pipelineInfo);
 	switch(res.result) {
 		case vk::Result::eSuccess:
 			_pipeline = res.value;
@@ -92,15 +74,11 @@ GraphicsPipeline::~GraphicsPipeline() {
 		device.destroyPipeline(pipeline());
 	}
 
-	for(auto& l : _descriptor_set_layouts) {
-		device.destroyDescriptorSetLayout(l);
+	for(size_t i = 0; i < _owned_layouts; i++) {
+		device.destroyDescriptorSetLayout(_descriptor_set_layouts[i]);
 	}
 	_descriptor_set_layouts.clear();
 
-	if (_render_pass) {
-		device.destroyRenderPass(_render_pass);
-	}
-
 	if (_pipeline_layout) {
 		device.destroyPipelineLayout(_pipeline_layout);
 	}
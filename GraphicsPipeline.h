@@ -1,38 +1,32 @@
 #ifndef VKOCCLUSIONTEST_GRAPHICSPIPELINE_H
 #define VKOCCLUSIONTEST_GRAPHICSPIPELINE_H
 
-#include <filesystem>
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
 #include "Instance.h"
-#include <filesystem>
 #include <memory>
 #include <optional>
-
-std::vector<char> readFile(const std::filesystem::path& path);
-
-template<typename SourceT, typename TargetT>
-std::vector<TargetT> reinterpret_data(const std::vector<SourceT>& data);
-
-struct GraphicsPipelineAttachment {
-	vk::Format format;
-	vk::ImageLayout startLayout;
-	vk::ImageLayout endLayout;
-};
+#include <span>
 
 class GraphicsPipeline {
 private:
 	std::shared_ptr<Instance> instance;
 	vk::Pipeline _pipeline;
 	vk::PipelineLayout _pipeline_layout;
-	vk::RenderPass _render_pass;
+	// Attachments of the dynamic rendering instances the pipeline is used in
+	std::vector<vk::Format> _color_formats;
+	vk::Format _depth_format;
 	std::vector<vk::DescriptorSetLayout> _descriptor_set_layouts;
+	// The first ones are created from 'bindings', the shared ones after them are owned elsewhere
+	size_t _owned_layouts;
 
 	std::vector<vk::ShaderModule> modules;
 public:
-	GraphicsPipeline(std::shared_ptr<Instance> instance, const std::filesystem::path& vsPath, const std::filesystem::path& fsPath,
-					 const std::vector<std::vector<vk::DescriptorSetLayoutBinding>>& bindings, const std::vector<vk::SubpassDependency>& dependencies,
-					 const std::vector<GraphicsPipelineAttachment>& colorAttachments, const std::optional<GraphicsPipelineAttachment>& depthFormat);
+	GraphicsPipeline(std::shared_ptr<Instance> instance, const vk::PipelineCache& cache, std::span<const uint32_t> vsCode, std::span<const uint32_t> fsCode,
+					 const std::vector<std::vector<vk::DescriptorSetLayoutBinding>>& bindings,
+					 const std::vector<vk::Format>& colorFormats, const std::optional<vk::Format>& depthFormat,
+					 const std::vector<vk::PushConstantRange>& pushConstants = {},
+					 const std::vector<vk::DescriptorSetLayout>& sharedLayouts = {});
 
 	~GraphicsPipeline();
 
@@ -48,8 +42,18 @@ public:
 		return _pipeline_layout;
 	}
 
-	inline const vk::RenderPass& render_pass() const {
-		return _render_pass;
+	inline const std::vector<vk::Format>& color_formats() const {
+		return _color_formats;
+	}
+
+	// eUndefined without a depth attachment
+	inline vk::Format depth_format() const {
+		return _depth_format;
+	}
+
+	// For secondary command buffers executed inside a rendering instance of this pipeline's attachments
+	inline vk::CommandBufferInheritanceRenderingInfo inheritance_rendering_info() const {
+		return vk::CommandBufferInheritanceRenderingInfo({}, 0, _color_formats, _depth_format, vk::Format::eUndefined, vk::SampleCountFlagBits::e1);
 	}
 
 	inline const std::vector<vk::DescriptorSetLayout>& descriptor_set_layouts() const {
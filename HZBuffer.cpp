@@ -1,10 +1,57 @@
 #include "HZBuffer.h"
 #include <stdexcept>
+#include <cmath>
 
-HZBuffer::HZBuffer(std::shared_ptr<Instance> inst, glm::ivec2 size, const vk::DescriptorSetLayout& downsampleLayout, const vk::Sampler& downsampleSampler) :
-	instance(std::move(inst)), _texture(instance, vk::Format::eR32Sfloat, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage, size),
-	_depth_texture(instance, vk::Format::eD32Sfloat, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled, size)
+//Nearest power of two in log space, so each side stays within a factor of sqrt(2) of what was asked for
+static int nearest_power_of_two(float value) {
+	return 1 << static_cast<int>(std::round(std::log2(std::max(value, 1.0f))));
+}
+
+//Largest power of two that is not above the value
+static int power_of_two_below(float value) {
+	return 1 << static_cast<int>(std::floor(std::log2(std::max(value, 1.0f))));
+}
+
+glm::ivec2 HZBPolicy::size_for(glm::ivec2 renderSize) const {
+	if (sizing == HZBSizing::eFixed) {
+		return { nearest_power_of_two(static_cast<float>(fixedSize.x)), nearest_power_of_two(static_cast<float>(fixedSize.y)) };
+	}
+
+	glm::ivec2 size;
+	if (sizing == HZBSizing::eFraction) {
+		auto fraction = 1.0f / static_cast<float>(std::max(divisor, 1U));
+		size = { nearest_power_of_two(renderSize.x * fraction), nearest_power_of_two(renderSize.y * fraction) };
+	} else {
+		size = { power_of_two_below(static_cast<float>(renderSize.x)), power_of_two_below(static_cast<float>(renderSize.y)) };
+		while(memory_bytes(size) > budget && (size.x > 1 || size.y > 1)) {
+			size = glm::max(size / 2, glm::ivec2(1));
+		}
+	}
+
+	return size;
+}
+
+vk::DeviceSize HZBPolicy::memory_bytes(glm::ivec2 size) {
+	auto texels = [](glm::ivec2 s) { return static_cast<vk::DeviceSize>(s.x) * s.y; };
+
+	vk::DeviceSize bytes = texels(size) * sizeof(float);
+	bytes += texels(size) * sizeof(float);
+	while(size.x > 1 || size.y > 1) {
+		size = glm::max(size / 2, glm::ivec2(1));
+		bytes += texels(size) * sizeof(float);
+	}
+	return bytes;
+}
+
+HZBuffer::HZBuffer(std::shared_ptr<Instance> inst, const Texture& texture, const Texture& depthTexture, const vk::DescriptorSetLayout& downsampleLayout,
+				   const vk::Sampler& downsampleSampler, bool sampledSource) :
+	instance(std::move(inst)), _texture(texture), _depth_texture(depthTexture)
 {
+	if (_texture.size() != _depth_texture.size()) {
+		throw std::runtime_error("HZB and depth size mismatch");
+	}
+
+	auto size = _texture.size();
 	_sizes.push_back(size);
 	//Calculate MIP sizes
 	while(size.x > 1 || size.y > 1) {
@@ -46,13 +93,15 @@ HZBuffer::HZBuffer(std::shared_ptr<Instance> inst, glm::ivec2 size, const vk::De
 	std::vector<vk::WriteDescriptorSet> writeOperations;
 	writeOperations.reserve(2 * (_texture.levels() - 1));
 
+	//The whole pyramid stays in the general layout while it is built, sampled levels included
+	auto sourceType = sampledSource ? vk::DescriptorType::eCombinedImageSampler : vk::DescriptorType::eStorageImage;
 	for(int level = 1; level < _texture.levels(); level++) {
-		imageInfos.emplace_back(nullptr, _level_views[level - 1], vk::ImageLayout::eGeneral);
+		imageInfos.emplace_back(sampledSource ? downsampleSampler : vk::Sampler(), _level_views[level - 1], vk::ImageLayout::eGeneral);
 		imageInfos.emplace_back(nullptr, _level_views[level], vk::ImageLayout::eGeneral);
 
 		auto* ptr0 = &imageInfos[(level - 1) * 2];
 		auto* ptr1 = &imageInfos[((level - 1) * 2) + 1];
-		vk::WriteDescriptorSet write0(_downsample_descriptor_sets[level - 1], 0, 0, 1, vk::DescriptorType::eStorageImage, ptr0); //I did not realize the last parameter took a pointer
+		vk::WriteDescriptorSet write0(_downsample_descriptor_sets[level - 1], 0, 0, 1, sourceType, ptr0); //I did not realize the last parameter took a pointer
 		vk::WriteDescriptorSet write1(_downsample_descriptor_sets[level - 1], 1, 0, 1, vk::DescriptorType::eStorageImage, ptr1); //and not a copy....
 
 		writeOperations.push_back(write0);
@@ -60,7 +109,6 @@ HZBuffer::HZBuffer(std::shared_ptr<Instance> inst, glm::ivec2 size, const vk::De
 	}
 
 	instance->device().updateDescriptorSets(writeOperations, nullptr);
-	instance->device().waitIdle();
 }
 
 HZBuffer::~HZBuffer() {
@@ -71,6 +119,10 @@ HZBuffer::~HZBuffer() {
 	instance->device().destroyImageView(_depth_view);
 	instance->device().destroyImageView(_full_view);
 
+	if (!_downsample_descriptor_sets.empty()) {
+		instance->free_descriptor_sets(_downsample_descriptor_sets);
+	}
+
 	_level_views.clear();
 	_sizes.clear();
 }
@@ -8,18 +8,46 @@
 #include <memory>
 #include <glm/glm.hpp>
 
+enum class HZBSizing {
+	// HZBPolicy::fixedSize, each side rounded to the nearest power of two
+	eFixed,
+	// Render size divided by HZBPolicy::divisor, each side rounded to the nearest power of two
+	eFraction,
+	// Largest power of two sides at or below the render size whose pyramid and depth fit in HZBPolicy::budget
+	eBudget
+};
+
+// How the HZB is sized from the render size. Every side is a power of two, so each level halves the previous one exactly
+struct HZBPolicy {
+	HZBSizing sizing = HZBSizing::eFraction;
+	glm::ivec2 fixedSize = { 1024, 512 };
+	uint32_t divisor = 2;
+	vk::DeviceSize budget = 8 * 1024 * 1024;
+
+	glm::ivec2 size_for(glm::ivec2 renderSize) const;
+
+	// Memory of the R32 pyramid and the D32 depth it is built from
+	static vk::DeviceSize memory_bytes(glm::ivec2 size);
+};
+
+// Views and downsample sets of a HZB and the depth it is built from, both images are owned by the caller
 class HZBuffer {
 private:
 	std::shared_ptr<Instance> instance;
-	Texture _texture;
-	Texture _depth_texture;
+	const Texture& _texture;
+	const Texture& _depth_texture;
 	std::vector<glm::ivec2> _sizes;
 	vk::ImageView _depth_view;
 	vk::ImageView _full_view;
 	std::vector<vk::ImageView> _level_views;
 	std::vector<vk::DescriptorSet> _downsample_descriptor_sets;
 public:
-	HZBuffer(std::shared_ptr<Instance> inst, glm::ivec2 size, const vk::DescriptorSetLayout& downsampleLayout, const vk::Sampler& downsampleSampler);
+	// With 'sampledSource' the downsample sets read the previous level through 'downsampleSampler' instead of as a storage image
+	HZBuffer(std::shared_ptr<Instance> inst, const Texture& texture, const Texture& depthTexture, const vk::DescriptorSetLayout& downsampleLayout,
+			 const vk::Sampler& downsampleSampler, bool sampledSource = false);
+
+	HZBuffer(const HZBuffer&) = delete;
+	HZBuffer(HZBuffer&&) = delete;
 	~HZBuffer();
 
 	inline const Texture& texture() const {
@@ -1,12 +1,14 @@
 #include "Instance.h"
 #include <SDL2/SDL_vulkan.h>
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
 #include "Swapchain.h"
 #include "Buffer.h"
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
-Instance::Instance(SDL_Window* window) {
+Instance::Instance(SDL_Window* window) : _present_wait_supported(false), _timestamps_supported(false), _minmax_reduction_supported(false), _draw_indirect_count_supported(false), _bc_compression_supported(false), _timestamp_period(0.0f), _timestamp_mask(0) {
 
 	uint32_t extension_count = 0;
 	if(!SDL_Vulkan_GetInstanceExtensions(window, &extension_count, nullptr)) {
@@ -112,8 +114,77 @@ void Instance::create_device(const Swapchain &swapchain) {
 	std::vector<const char*> validationLayers { "VK_LAYER_KHRONOS_validation" };
 	std::vector<const char*> deviceExtensions { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
+	vk::PhysicalDeviceVulkan12Features vulkan12Features;
+	vulkan12Features.bufferDeviceAddress = true;
+
+	auto supportedFeatures = _physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+
+	//Compacted draws need vkCmdDrawIndirectCount, every batch is drawn without it
+	if (supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount) {
+		vulkan12Features.drawIndirectCount = true;
+		_draw_indirect_count_supported = true;
+	}
+
+	//Min/max sampler reduction builds and queries the HZB with fewer fetches, the shaders fall back to plain loads without it
+	auto hzbFormatFeatures = _physical_device.getFormatProperties(vk::Format::eR32Sfloat).optimalTilingFeatures;
+	if (supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>().samplerFilterMinmax && (hzbFormatFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterMinmax)) {
+		vulkan12Features.samplerFilterMinmax = true;
+		_minmax_reduction_supported = true;
+	}
+
+	//Material textures are a single bindless array, indexed per fragment and filled in while frames are in flight
+	const auto& supported12 = supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>();
+	if (!supported12.runtimeDescriptorArray || !supported12.shaderSampledImageArrayNonUniformIndexing || !supported12.descriptorBindingPartiallyBound ||
+		!supported12.descriptorBindingVariableDescriptorCount || !supported12.descriptorBindingSampledImageUpdateAfterBind ||
+		!supported12.descriptorBindingUpdateUnusedWhilePending) {
+		throw std::runtime_error("Descriptor indexing for bindless textures is not supported");
+	}
+	vulkan12Features.runtimeDescriptorArray = true;
+	vulkan12Features.shaderSampledImageArrayNonUniformIndexing = true;
+	vulkan12Features.descriptorBindingPartiallyBound = true;
+	vulkan12Features.descriptorBindingVariableDescriptorCount = true;
+	vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = true;
+	vulkan12Features.descriptorBindingUpdateUnusedWhilePending = true;
+
+	//Frame graph barriers are recorded with vkCmdPipelineBarrier2, graphics passes render without render pass objects
+	vk::PhysicalDeviceVulkan13Features vulkan13Features;
+	vulkan13Features.synchronization2 = true;
+	vulkan13Features.dynamicRendering = true;
+	vulkan12Features.setPNext(&vulkan13Features);
+
 	vk::PhysicalDeviceFeatures2 deviceFeatures;
 	deviceFeatures.features.samplerAnisotropy = true;
+	//Block compressed material textures are optional, loading them is refused without it
+	if (supportedFeatures.get<vk::PhysicalDeviceFeatures2>().features.textureCompressionBC) {
+		deviceFeatures.features.textureCompressionBC = true;
+		_bc_compression_supported = true;
+	}
+	deviceFeatures.setPNext(&vulkan12Features);
+
+	//Present wait is optional, it is only used to measure latency up to the actual present
+	auto availableExtensions = _physical_device.enumerateDeviceExtensionProperties();
+	auto hasExtension = [&availableExtensions](const char* name) {
+		return std::any_of(availableExtensions.begin(), availableExtensions.end(), [name](const vk::ExtensionProperties& e) {
+			return std::strcmp(e.extensionName.data(), name) == 0;
+		});
+	};
+
+	vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures;
+	vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures;
+	if (hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+		vk::PhysicalDeviceFeatures2 supported;
+		supported.setPNext(&presentIdFeatures);
+		presentIdFeatures.setPNext(&presentWaitFeatures);
+		_physical_device.getFeatures2(&supported);
+
+		if (presentIdFeatures.presentId && presentWaitFeatures.presentWait) {
+			deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			presentWaitFeatures.setPNext(nullptr);
+			vulkan13Features.setPNext(&presentIdFeatures);
+			_present_wait_supported = true;
+		}
+	}
 
 	vk::DeviceCreateInfo deviceCreateInfo({}, queueCreateInfos, validationLayers, deviceExtensions, nullptr);
 	deviceCreateInfo.setPNext(&deviceFeatures);
@@ -129,6 +200,15 @@ void Instance::create_device(const Swapchain &swapchain) {
 
 	_memory_properties = _physical_device.getMemoryProperties();
 
+	//Timestamps are only used for profiling, a queue without them just disables GPU timings
+	auto validBits = queue_properties[_graphics_index].timestampValidBits;
+	_timestamp_period = _physical_device.getProperties().limits.timestampPeriod;
+	_timestamp_mask = validBits >= 64 ? UINT64_MAX : (1ULL << validBits) - 1;
+	_timestamps_supported = validBits > 0;
+
+	auto properties = _physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+	_subgroup_properties = properties.get<vk::PhysicalDeviceSubgroupProperties>();
+
 	std::array<vk::DescriptorPoolSize, 4> sizes = {
 			vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, 100),
 			vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 100),
@@ -136,7 +216,8 @@ void Instance::create_device(const Swapchain &swapchain) {
 			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 100)
 	};
 
-	_descriptor_pool = _device.createDescriptorPool({{}, 1000, sizes});
+	//Sets of images recreated on resize are freed individually
+	_descriptor_pool = _device.createDescriptorPool({vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 1000, sizes});
 }
 
 void Instance::wait_idle() const {
@@ -157,6 +238,10 @@ std::vector<vk::DescriptorSet> Instance::create_descriptor_sets(const vk::ArrayP
 	return _device.allocateDescriptorSets({_descriptor_pool, info});
 }
 
+void Instance::free_descriptor_sets(const vk::ArrayProxy<vk::DescriptorSet>& sets) {
+	_device.freeDescriptorSets(_descriptor_pool, sets);
+}
+
 const std::unique_ptr<Buffer> &Instance::get_transfer_buffer(const std::shared_ptr<Instance>& instance, size_t size) {
 	if (instance->_transfer_buffer == nullptr || instance->_transfer_buffer->size() < size) {
 		instance->_transfer_buffer = std::make_unique<Buffer>(instance, size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
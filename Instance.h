@@ -23,6 +23,14 @@ private:
 	uint32_t _graphics_index;
 	uint32_t _present_index;
 	uint32_t _compute_index;
+	bool _present_wait_supported;
+	bool _timestamps_supported;
+	bool _minmax_reduction_supported;
+	bool _draw_indirect_count_supported;
+	bool _bc_compression_supported;
+	float _timestamp_period;
+	uint64_t _timestamp_mask;
+	vk::PhysicalDeviceSubgroupProperties _subgroup_properties;
 	std::unique_ptr<Buffer> _transfer_buffer;
 public:
 	Instance(SDL_Window* window);
@@ -31,6 +39,7 @@ public:
 	void create_device(const Swapchain& swapchain);
 	void wait_idle() const;
 	std::vector<vk::DescriptorSet> create_descriptor_sets(const vk::ArrayProxy<vk::DescriptorSetLayout>& info);
+	void free_descriptor_sets(const vk::ArrayProxy<vk::DescriptorSet>& sets);
 	static const std::unique_ptr<Buffer>& get_transfer_buffer(const std::shared_ptr<Instance>& instance, size_t size);
 
 	inline const vk::Instance& instance() const {
@@ -92,6 +101,45 @@ public:
 	inline const vk::PhysicalDeviceMemoryProperties& memory_properties() const {
 		return _memory_properties;
 	}
+
+	// VK_KHR_present_id and VK_KHR_present_wait are both enabled
+	inline bool present_wait_supported() const {
+		return _present_wait_supported;
+	}
+
+	// Graphics queue can write timestamps
+	inline bool timestamps_supported() const {
+		return _timestamps_supported;
+	}
+
+	// Nanoseconds per timestamp tick
+	inline float timestamp_period() const {
+		return _timestamp_period;
+	}
+
+	// Bits of a timestamp that are valid on the graphics queue
+	inline uint64_t timestamp_mask() const {
+		return _timestamp_mask;
+	}
+
+	// samplerFilterMinmax is enabled and R32 float images can be filtered with min and max reduction
+	inline bool minmax_reduction_supported() const {
+		return _minmax_reduction_supported;
+	}
+
+	// drawIndirectCount is enabled, draws can take their count from a buffer
+	inline bool draw_indirect_count_supported() const {
+		return _draw_indirect_count_supported;
+	}
+
+	// textureCompressionBC is enabled, BC1 to BC7 textures can be sampled
+	inline bool bc_compression_supported() const {
+		return _bc_compression_supported;
+	}
+
+	inline const vk::PhysicalDeviceSubgroupProperties& subgroup_properties() const {
+		return _subgroup_properties;
+	}
 };
 
 #endif //VKOCCLUSIONTEST_INSTANCE_H
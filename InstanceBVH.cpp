@@ -0,0 +1,173 @@
+#include "InstanceBVH.h"
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <set>
+#include <limits>
+
+static float surface_area(const glm::vec3& min, const glm::vec3& max) {
+	auto size = glm::max(max - min, glm::vec3(0.0f));
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+InstanceBVH::InstanceBVH() : _buildVersion(0), _builtArea(0.0f), _area(0.0f) {
+
+}
+
+void InstanceBVH::update_bounds(uint32_t node, const std::vector<InstanceBounds>& bounds) {
+	auto& n = _nodes[node];
+	glm::vec3 min(std::numeric_limits<float>::max());
+	glm::vec3 max(std::numeric_limits<float>::lowest());
+
+	if (n.flags & BVH_NODE_LEAF) {
+		for(uint32_t i = n.first; i < n.first + n.count; i++) {
+			const auto& b = bounds[_leafInstances[i]];
+			min = glm::min(min, b.min);
+			max = glm::max(max, b.max);
+		}
+	} else {
+		for(uint32_t i = n.first; i < n.first + n.count; i++) {
+			min = glm::min(min, glm::vec3(_nodes[i].boundsMin));
+			max = glm::max(max, glm::vec3(_nodes[i].boundsMax));
+		}
+	}
+
+	n.boundsMin = glm::vec4(min, 0.0f);
+	n.boundsMax = glm::vec4(max, 0.0f);
+}
+
+void InstanceBVH::build(const std::vector<InstanceBounds>& bounds, uint64_t version) {
+	auto amount = static_cast<uint32_t>(bounds.size());
+
+	_nodes.clear();
+	_parents.clear();
+	_levels.clear();
+	_leafInstances.resize(amount);
+	std::iota(_leafInstances.begin(), _leafInstances.end(), 0);
+	_slotLeaves.assign(amount, 0);
+	_buildVersion = version;
+	_builtArea = 0.0f;
+
+	if (amount == 0) {
+		_nodeVersions.clear();
+		_area = 0.0f;
+		return;
+	}
+
+	std::vector<glm::vec3> centroids(amount);
+	for(uint32_t i = 0; i < amount; i++) {
+		centroids[i] = 0.5f * (bounds[i].min + bounds[i].max);
+	}
+
+	//Median split along the longest axis of the range's centroids, instances stay grouped by leaf in _leafInstances
+	auto split = [&](uint32_t begin, uint32_t end) {
+		glm::vec3 min(std::numeric_limits<float>::max());
+		glm::vec3 max(std::numeric_limits<float>::lowest());
+		for(uint32_t i = begin; i < end; i++) {
+			min = glm::min(min, centroids[_leafInstances[i]]);
+			max = glm::max(max, centroids[_leafInstances[i]]);
+		}
+
+		auto extent = max - min;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		auto mid = begin + (end - begin) / 2;
+		std::nth_element(_leafInstances.begin() + begin, _leafInstances.begin() + mid, _leafInstances.begin() + end,
+						 [&](uint32_t left, uint32_t right) { return centroids[left][axis] < centroids[right][axis]; });
+		return mid;
+	};
+
+	//Breadth first: children are appended while their parent's level is walked, so each level ends up contiguous
+	std::vector<std::pair<uint32_t, uint32_t>> ranges { { 0, amount } };
+	std::vector<uint32_t> depths { 0 };
+	_nodes.push_back({});
+	_parents.push_back(0);
+
+	for(uint32_t i = 0; i < _nodes.size(); i++) {
+		auto [begin, end] = ranges[i];
+		if (depths[i] == _levels.size()) {
+			_levels.push_back({ i, 0 });
+		}
+		_levels.back().count++;
+
+		if (end - begin <= BVH_LEAF_SIZE || depths[i] + 1 >= BVH_MAX_LEVELS) {
+			_nodes[i].first = begin;
+			_nodes[i].count = end - begin;
+			_nodes[i].flags = BVH_NODE_LEAF;
+			for(uint32_t j = begin; j < end; j++) {
+				_slotLeaves[_leafInstances[j]] = i;
+			}
+			continue;
+		}
+
+		//Repeated halving of the largest part, each along its own longest axis
+		std::vector<std::pair<uint32_t, uint32_t>> parts { { begin, end } };
+		while(parts.size() < BVH_BRANCHING) {
+			auto largest = std::max_element(parts.begin(), parts.end(), [](const auto& left, const auto& right) {
+				return left.second - left.first < right.second - right.first;
+			});
+			auto [partBegin, partEnd] = *largest;
+			auto mid = split(partBegin, partEnd);
+			*largest = { partBegin, mid };
+			parts.insert(largest + 1, { mid, partEnd });
+		}
+
+		_nodes[i].first = static_cast<uint32_t>(_nodes.size());
+		_nodes[i].count = static_cast<uint32_t>(parts.size());
+		_nodes[i].flags = BVH_NODE_NONE;
+		for(const auto& part : parts) {
+			_nodes.push_back({});
+			_parents.push_back(i);
+			ranges.push_back(part);
+			depths.push_back(depths[i] + 1);
+		}
+	}
+
+	//Children come after their parents, so walking backwards fits every child before its parent
+	for(auto i = static_cast<uint32_t>(_nodes.size()); i-- > 0;) {
+		update_bounds(i, bounds);
+		if (_nodes[i].flags & BVH_NODE_LEAF) {
+			_builtArea += surface_area(glm::vec3(_nodes[i].boundsMin), glm::vec3(_nodes[i].boundsMax));
+		}
+	}
+
+	_area = _builtArea;
+	_nodeVersions.assign(_nodes.size(), version);
+}
+
+void InstanceBVH::refit(const std::vector<InstanceBounds>& bounds, const std::vector<uint32_t>& slots, uint64_t version) {
+	if (_nodes.empty() || slots.empty()) {
+		return;
+	}
+
+	//Highest index first, so every dirty child is refit before its parent
+	std::set<uint32_t, std::greater<>> dirty;
+	for(auto slot : slots) {
+		dirty.insert(_slotLeaves[slot]);
+	}
+
+	while(!dirty.empty()) {
+		auto node = *dirty.begin();
+		dirty.erase(dirty.begin());
+
+		auto min = _nodes[node].boundsMin;
+		auto max = _nodes[node].boundsMax;
+		update_bounds(node, bounds);
+		if (_nodes[node].boundsMin == min && _nodes[node].boundsMax == max) {
+			continue;
+		}
+
+		if (_nodes[node].flags & BVH_NODE_LEAF) {
+			_area += surface_area(glm::vec3(_nodes[node].boundsMin), glm::vec3(_nodes[node].boundsMax)) - surface_area(glm::vec3(min), glm::vec3(max));
+		}
+
+		_nodeVersions[node] = version;
+		if (node != 0) {
+			dirty.insert(_parents[node]);
+		}
+	}
+
+	//Leaves only ever grow around instances that drifted apart, past some point a new tree culls better
+	if (_area > BVH_REBUILD_AREA_RATIO * _builtArea) {
+		build(bounds, version);
+	}
+}
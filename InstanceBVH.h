@@ -0,0 +1,77 @@
+#ifndef VKOCCLUSIONTEST_INSTANCEBVH_H
+#define VKOCCLUSIONTEST_INSTANCEBVH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "GlobalTypes.h"
+
+// Children per inner node, fewer levels mean fewer dispatches during traversal
+#define BVH_BRANCHING 4
+// Instances at which a node stops being split
+#define BVH_LEAF_SIZE 32
+// Levels the traversal has dispatch lists for, a balanced tree of BVH_BRANCHING never gets close
+#define BVH_MAX_LEVELS 24
+// Leaves may grow to this multiple of their summed surface area at build time before refits give way to a rebuild
+#define BVH_REBUILD_AREA_RATIO 2.0f
+
+struct InstanceBounds {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// Nodes of one level, contiguous since nodes are stored breadth first
+struct BVHLevel {
+	uint32_t first;
+	uint32_t count;
+};
+
+// Bounding volume hierarchy over instance slots. Nodes are stored breadth first, so every level is a range of
+// nodes, parents come before their children and the children of a node are next to each other
+class InstanceBVH {
+private:
+	std::vector<BVHNode> _nodes;
+	std::vector<uint32_t> _parents;
+	std::vector<BVHLevel> _levels;
+	// Instance slots in leaf order, leaves own a range of them
+	std::vector<uint32_t> _leafInstances;
+	// Leaf holding each instance slot
+	std::vector<uint32_t> _slotLeaves;
+	// Version each node last changed at, and the version the tree was last rebuilt at
+	std::vector<uint64_t> _nodeVersions;
+	uint64_t _buildVersion;
+	float _builtArea;
+	float _area;
+
+	void update_bounds(uint32_t node, const std::vector<InstanceBounds>& bounds);
+public:
+	InstanceBVH();
+
+	// Rebuilds the whole tree over 'bounds', indexed by instance slot
+	void build(const std::vector<InstanceBounds>& bounds, uint64_t version);
+	// Refits the leaves holding 'slots' and their ancestors, or rebuilds when refitting degraded the tree too much
+	void refit(const std::vector<InstanceBounds>& bounds, const std::vector<uint32_t>& slots, uint64_t version);
+
+	inline const std::vector<BVHNode>& nodes() const {
+		return _nodes;
+	}
+
+	inline const std::vector<BVHLevel>& levels() const {
+		return _levels;
+	}
+
+	inline const std::vector<uint32_t>& leaf_instances() const {
+		return _leafInstances;
+	}
+
+	inline const std::vector<uint64_t>& node_versions() const {
+		return _nodeVersions;
+	}
+
+	// Leaf instances and the node layout only change when rebuilding
+	inline uint64_t build_version() const {
+		return _buildVersion;
+	}
+};
+
+#endif //VKOCCLUSIONTEST_INSTANCEBVH_H
@@ -0,0 +1,66 @@
+#include "MaterialLibrary.h"
+
+MaterialLibrary::MaterialLibrary(std::shared_ptr<Instance> inst, const vk::DescriptorSetLayout& layout, uint32_t maxTextureCount, size_t maxMaterialCount) :
+	instance(std::move(inst)), _maxTextureCount(maxTextureCount), _maxMaterialCount(maxMaterialCount), _materialCount(0) {
+	auto device = instance->device();
+
+	vk::DescriptorPoolSize size(vk::DescriptorType::eCombinedImageSampler, _maxTextureCount);
+	_pool = device.createDescriptorPool({vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind, 1, size});
+
+	//The texture array is sized per set, slots past the added textures stay unbound
+	vk::DescriptorSetVariableDescriptorCountAllocateInfo countInfo(_maxTextureCount);
+	vk::DescriptorSetAllocateInfo allocateInfo(_pool, layout);
+	allocateInfo.setPNext(&countInfo);
+	_set = device.allocateDescriptorSets(allocateInfo)[0];
+
+	//Trilinear over every level the textures were uploaded with
+	_sampler = std::make_unique<Sampler>(instance, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear,
+										 vk::SamplerReductionMode::eWeightedAverage, VK_LOD_CLAMP_NONE);
+	_table = std::make_unique<Buffer>(instance, sizeof(MaterialData) * maxMaterialCount, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress, vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+MaterialLibrary::~MaterialLibrary() {
+	auto device = instance->device();
+	for(auto& v : _views) {
+		device.destroyImageView(v);
+	}
+	_views.clear();
+
+	//Frees _set along with it
+	device.destroyDescriptorPool(_pool);
+}
+
+uint32_t MaterialLibrary::add_texture(std::unique_ptr<Texture> texture) {
+	if (_textures.size() >= _maxTextureCount) {
+		throw std::runtime_error("Too many textures in material library");
+	}
+
+	vk::ComponentMapping mapping(vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA);
+	vk::ImageViewCreateInfo viewInfo({}, texture->image(), vk::ImageViewType::e2D, texture->format(), mapping, {vk::ImageAspectFlagBits::eColor, 0, texture->levels(), 0, 1});
+	auto view = instance->device().createImageView(viewInfo);
+
+	auto slot = static_cast<uint32_t>(_textures.size());
+	vk::DescriptorImageInfo imageInfo(_sampler->sampler(), view, vk::ImageLayout::eShaderReadOnlyOptimal);
+	instance->device().updateDescriptorSets(vk::WriteDescriptorSet(_set, 0, slot, vk::DescriptorType::eCombinedImageSampler, imageInfo, nullptr, nullptr), nullptr);
+
+	_textures.push_back(std::move(texture));
+	_views.push_back(view);
+
+	return slot + 1;
+}
+
+uint32_t MaterialLibrary::add_material(glm::vec4 color, uint32_t baseColorTexture, const vk::CommandBuffer& cmdBuffer) {
+	if (_materialCount >= _maxMaterialCount) {
+		throw std::runtime_error("Too many materials in material table");
+	}
+
+	if (baseColorTexture > _textures.size()) {
+		throw std::runtime_error("Unknown material texture");
+	}
+
+	//Like mesh table entries, a single material is small enough to be recorded inline
+	MaterialData data(color, glm::ivec4(baseColorTexture, MATERIAL_TEXTURE_NONE, MATERIAL_TEXTURE_NONE, MATERIAL_TEXTURE_NONE));
+	cmdBuffer.updateBuffer(_table->buffer(), _materialCount * sizeof(MaterialData), sizeof(MaterialData), &data);
+
+	return _materialCount++;
+}
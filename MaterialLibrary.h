@@ -0,0 +1,64 @@
+#ifndef VKOCCLUSIONTEST_MATERIALLIBRARY_H
+#define VKOCCLUSIONTEST_MATERIALLIBRARY_H
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include "Instance.h"
+#include "Buffer.h"
+#include "Texture.h"
+#include "Sampler.h"
+#include "GlobalTypes.h"
+#include <memory>
+#include <vector>
+
+#define MATERIAL_TABLE_DEFAULT_CAPACITY 4096
+// Texture id of a material without that texture, ids of added textures start at 1
+#define MATERIAL_TEXTURE_NONE 0
+
+// Materials of every object and the textures they sample. Materials are a table of MaterialData indexed by
+// Object::materialId, textures a single bindless array indexed by MaterialData::textureIds, so any number of
+// materials is drawn with one descriptor set bound once per frame
+class MaterialLibrary {
+private:
+	std::shared_ptr<Instance> instance;
+	// Update after bind sets need a pool of their own
+	vk::DescriptorPool _pool;
+	vk::DescriptorSet _set;
+	std::unique_ptr<Sampler> _sampler;
+	std::vector<std::unique_ptr<Texture>> _textures;
+	std::vector<vk::ImageView> _views;
+	uint32_t _maxTextureCount;
+	// MaterialData for every material, read by the draw pass
+	std::unique_ptr<Buffer> _table;
+	size_t _maxMaterialCount;
+	uint32_t _materialCount;
+public:
+	// 'layout' is PipelineCollection::material_set_layout(), 'maxTextureCount' at most PipelineCollection::material_texture_capacity()
+	MaterialLibrary(std::shared_ptr<Instance> instance, const vk::DescriptorSetLayout& layout, uint32_t maxTextureCount, size_t maxMaterialCount = MATERIAL_TABLE_DEFAULT_CAPACITY);
+	~MaterialLibrary();
+
+	// Takes a texture that is in eShaderReadOnlyOptimal by the time it is drawn with, returns its id.
+	// Frames in flight never sample a new slot, so this does not wait for them
+	uint32_t add_texture(std::unique_ptr<Texture> texture);
+	// 'color' multiplies the vertex color and the base color texture, MATERIAL_TEXTURE_NONE samples nothing
+	uint32_t add_material(glm::vec4 color, uint32_t baseColorTexture, const vk::CommandBuffer& cmdBuffer);
+
+	inline const vk::DescriptorSet& descriptor_set() const {
+		return _set;
+	}
+
+	inline const std::unique_ptr<Buffer>& table() const {
+		return _table;
+	}
+
+	// Objects with a material id past this are drawn with a default white material
+	inline uint32_t material_count() const {
+		return _materialCount;
+	}
+
+	inline size_t texture_count() const {
+		return _textures.size();
+	}
+};
+
+#endif //VKOCCLUSIONTEST_MATERIALLIBRARY_H
@@ -1,7 +1,8 @@
 #include "Mesh.h"
 
-MeshBuffer::MeshBuffer(std::shared_ptr<Instance> inst, size_t maxVertexCount) : instance(std::move(inst)), _maxVertexCount(maxVertexCount), _nextFreeSlot(0) {
-	_buffer = std::make_unique<Buffer>(instance, sizeof(Vertex) * maxVertexCount, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+MeshBuffer::MeshBuffer(std::shared_ptr<Instance> inst, size_t maxVertexCount, size_t maxMeshCount) : instance(std::move(inst)), _maxVertexCount(maxVertexCount), _nextFreeSlot(0), _maxMeshCount(maxMeshCount) {
+	_buffer = std::make_unique<Buffer>(instance, sizeof(Vertex) * maxVertexCount, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	_table = std::make_unique<Buffer>(instance, sizeof(MeshData) * maxMeshCount, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress, vk::MemoryPropertyFlagBits::eDeviceLocal);
 }
 
 size_t MeshBuffer::append(const std::vector<Vertex> &vertices, int meshType, glm::vec3 boundingBoxCenter, glm::vec3 boundingBoxExtents, const vk::CommandBuffer& cmdBuffer) {
@@ -9,6 +10,10 @@ size_t MeshBuffer::append(const std::vector<Vertex> &vertices, int meshType, glm
 		throw std::runtime_error("Too many vertices in mesh _buffer");
 	}
 
+	if (_meshes.size() >= _maxMeshCount) {
+		throw std::runtime_error("Too many meshes in mesh table");
+	}
+
 	auto dataSize = vertices.size() * sizeof(Vertex);
 	Mesh m(_meshes.size(), vertices.size(), _nextFreeSlot, meshType, boundingBoxCenter, boundingBoxExtents);
 
@@ -21,6 +26,10 @@ size_t MeshBuffer::append(const std::vector<Vertex> &vertices, int meshType, glm
 	cmdBuffer.copyBuffer(tmpBuffer->buffer(), _buffer->buffer(), vk::BufferCopy(0, _nextFreeSlot * sizeof(Vertex), dataSize));
 	_nextFreeSlot += vertices.size();
 
+	//A single entry is small enough to be recorded inline, without going through the (already used) transfer buffer
+	MeshData data(m.vertexAmount, m.vertexOffset, meshType, 0, glm::vec4(boundingBoxCenter, 1.0f), glm::vec4(boundingBoxExtents, 0.0f));
+	cmdBuffer.updateBuffer(_table->buffer(), m.meshId * sizeof(MeshData), sizeof(MeshData), &data);
+
 	_meshes.push_back(m);
 
 	return m.meshId;
@@ -7,6 +7,8 @@
 #include <vector>
 #include <memory>
 
+#define MESH_TABLE_DEFAULT_CAPACITY 4096
+
 struct Mesh {
 public:
 	size_t meshId;
@@ -23,9 +25,12 @@ private:
 	size_t _maxVertexCount;
 	size_t _nextFreeSlot;
 	std::unique_ptr<Buffer> _buffer;
+	// MeshData for every mesh, read by the GPU to build draw commands
+	std::unique_ptr<Buffer> _table;
+	size_t _maxMeshCount;
 	std::vector<Mesh> _meshes;
 public:
-	MeshBuffer(std::shared_ptr<Instance> instance, size_t maxVertexCount);
+	MeshBuffer(std::shared_ptr<Instance> instance, size_t maxVertexCount, size_t maxMeshCount = MESH_TABLE_DEFAULT_CAPACITY);
 	size_t append(const std::vector<Vertex>& vertices, int meshType, glm::vec3 boundingBoxCenter, glm::vec3 boundingBoxExtents, const vk::CommandBuffer& cmdBuffer);
 
 	inline const std::vector<Mesh>& meshes() const {
@@ -35,6 +40,10 @@ public:
 	inline const std::unique_ptr<Buffer>& buffer() const {
 		return _buffer;
 	}
+
+	inline const std::unique_ptr<Buffer>& table() const {
+		return _table;
+	}
 };
 
 #endif //VKOCCLUSIONTEST_MESH_H
@@ -0,0 +1,119 @@
+#include "PipelineCache.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <iostream>
+#include "Utils.h"
+
+#define PIPELINE_CACHE_HEADER_SIZE (4 * sizeof(uint32_t) + VK_UUID_SIZE)
+
+static std::filesystem::path cache_file_name(const vk::PhysicalDeviceProperties& props) {
+	std::stringstream name;
+	name << "pipelines_" << std::hex << std::setfill('0');
+	for(auto b : props.pipelineCacheUUID) {
+		name << std::setw(2) << (uint32_t) b;
+	}
+	name << "_" << std::setw(8) << props.driverVersion << ".bin";
+
+	return name.str();
+}
+
+PipelineCache::PipelineCache(std::shared_ptr<Instance> inst, const std::filesystem::path& directory) : instance(std::move(inst)), _loaded_from_disk(false) {
+	auto props = instance->physical_device().getProperties();
+	_path = directory / cache_file_name(props);
+
+	auto data = load_validated_data();
+	_loaded_from_disk = !data.empty();
+
+	_cache = instance->device().createPipelineCache({ {}, data.size(), data.empty() ? nullptr : data.data() });
+}
+
+std::vector<char> PipelineCache::load_validated_data() const {
+	std::error_code ec;
+	if (!std::filesystem::exists(_path, ec)) {
+		return {};
+	}
+
+	std::vector<char> data;
+	try {
+		data = readFile(_path);
+	} catch (const std::exception& e) {
+		std::cerr << "[PipelineCache] Failed to read " << _path << ": " << e.what() << std::endl;
+		return {};
+	}
+
+	if (data.size() < PIPELINE_CACHE_HEADER_SIZE) {
+		return {};
+	}
+
+	// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+	uint32_t headerSize, headerVersion, vendorId, deviceId;
+	uint8_t uuid[VK_UUID_SIZE];
+	std::memcpy(&headerSize, data.data(), sizeof(uint32_t));
+	std::memcpy(&headerVersion, data.data() + 4, sizeof(uint32_t));
+	std::memcpy(&vendorId, data.data() + 8, sizeof(uint32_t));
+	std::memcpy(&deviceId, data.data() + 12, sizeof(uint32_t));
+	std::memcpy(uuid, data.data() + 16, VK_UUID_SIZE);
+
+	auto props = instance->physical_device().getProperties();
+
+	if (headerSize < PIPELINE_CACHE_HEADER_SIZE || headerSize > data.size() ||
+		headerVersion != static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne) ||
+		vendorId != props.vendorID || deviceId != props.deviceID ||
+		std::memcmp(uuid, props.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+		std::cerr << "[PipelineCache] Discarding stale cache " << _path << std::endl;
+		return {};
+	}
+
+	return data;
+}
+
+bool PipelineCache::save() const {
+	if (!_cache) {
+		return false;
+	}
+
+	auto data = instance->device().getPipelineCacheData(_cache);
+	if (data.empty()) {
+		return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(_path.parent_path(), ec);
+
+	//Write to a temporary file and rename it over the old one, so a crash never leaves a truncated cache behind
+	auto tmpPath = _path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(data.data()), (std::streamsize) data.size());
+		file.flush();
+		if (!file) {
+			file.close();
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tmpPath, _path, ec);
+	if (ec) {
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+
+	return true;
+}
+
+PipelineCache::~PipelineCache() {
+	if (_cache) {
+		if (!save()) {
+			std::cerr << "[PipelineCache] Failed to write " << _path << std::endl;
+		}
+		instance->device().destroyPipelineCache(_cache);
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef VKOCCLUSIONTEST_PIPELINECACHE_H
+#define VKOCCLUSIONTEST_PIPELINECACHE_H
+
+#include <vulkan/vulkan.hpp>
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include "Instance.h"
+
+// Wraps a vk::PipelineCache that is persisted on disk between runs.
+// The file name is keyed by the device's pipeline cache UUID and driver version, and
+// the blob header is validated against the current device before it is handed to the driver.
+class PipelineCache {
+private:
+	std::shared_ptr<Instance> instance;
+	vk::PipelineCache _cache;
+	std::filesystem::path _path;
+	bool _loaded_from_disk;
+
+	std::vector<char> load_validated_data() const;
+public:
+	PipelineCache(std::shared_ptr<Instance> inst, const std::filesystem::path& directory);
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache(PipelineCache&&) = delete;
+	~PipelineCache();
+
+	// Atomically replaces the cache file with the current contents of the cache
+	bool save() const;
+
+	inline const vk::PipelineCache& cache() const {
+		return _cache;
+	}
+
+	inline operator const vk::PipelineCache&() const {
+		return _cache;
+	}
+
+	inline const std::filesystem::path& path() const {
+		return _path;
+	}
+
+	inline bool loaded_from_disk() const {
+		return _loaded_from_disk;
+	}
+};
+
+#endif //VKOCCLUSIONTEST_PIPELINECACHE_H
@@ -1,151 +1,323 @@
 #include "PipelineCollection.h"
 
 #include <memory>
-
-PipelineCollection::PipelineCollection(std::shared_ptr<Instance> inst, std::filesystem::path basePath) : instance(std::move(inst)), base_path(std::move(basePath)) {
-
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "Utils.h"
+
+PipelineCollection::PipelineCollection(std::shared_ptr<Instance> inst, std::shared_ptr<PipelineCache> pipelineCache, vk::Format outputFormat, bool hzbReduction,
+									   std::optional<std::filesystem::path> shaderOverridePath) :
+	instance(std::move(inst)), cache(std::move(pipelineCache)), shader_override_path(std::move(shaderOverridePath)), output_format(outputFormat),
+	reduction_sampler(hzbReduction && instance->minmax_reduction_supported()) {
+	//Tuning results are per device and driver, like the pipeline cache they are stored next to
+	tuner = std::make_unique<WorkgroupTuner>(instance, cache->path().parent_path());
+
+	//Material textures are one bindless array: partially bound, sized per set, and filled in while frames drawing with it are in flight.
+	//Combined image samplers count against both the sampler and the sampled image limits
+	auto limits = instance->physical_device().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>().get<vk::PhysicalDeviceVulkan12Properties>();
+	material_textures = std::min({ PIPELINE_MATERIAL_TEXTURES, limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+								   limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSamplers });
+
+	vk::DescriptorBindingFlags textureFlags = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eVariableDescriptorCount |
+											  vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+	vk::DescriptorSetLayoutBindingFlagsCreateInfo flagsInfo(textureFlags);
+	vk::DescriptorSetLayoutBinding textures(0, vk::DescriptorType::eCombinedImageSampler, material_textures, vk::ShaderStageFlagBits::eFragment, nullptr);
+	vk::DescriptorSetLayoutCreateInfo layoutInfo(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, textures);
+	layoutInfo.setPNext(&flagsInfo);
+	materialLayout = instance->device().createDescriptorSetLayout(layoutInfo);
 }
 
 const std::unique_ptr<GraphicsPipeline>& PipelineCollection::z_pass() {
-	if (zPass == nullptr) {
-		auto vsPath = base_path / "shaders" / "main.vert.spv";
-		auto fsPath = base_path / "shaders" / "main.frag.spv";
-
+	std::call_once(zPassOnce, [this]() {
+		ShaderCode vsCode("main.vert.spv", shader_override_path);
+		ShaderCode fsCode("main.frag.spv", shader_override_path);
 
 		std::vector<vk::DescriptorSetLayoutBinding> bindings {
-				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1,
-											   vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-											   nullptr),
-				vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eUniformBuffer, 1,
-											   vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-											   nullptr)
-		};
-		std::vector<vk::DescriptorSetLayoutBinding> bindings2 {
-				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1,
+				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1,
 											   vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
 											   nullptr)
 		};
 
-		std::vector<GraphicsPipelineAttachment> attachments;
-		std::optional<GraphicsPipelineAttachment> depth = GraphicsPipelineAttachment(PIPELINE_DEPTH_FORMAT, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferSrcOptimal);
-		std::vector<vk::SubpassDependency> dependencies;
+		std::vector<vk::Format> attachments;
+		std::optional<vk::Format> depth = PIPELINE_DEPTH_FORMAT;
 
-		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ bindings, bindings2 }};
+		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ bindings }};
 
-		zPass = std::make_unique<GraphicsPipeline>(instance, vsPath, fsPath, bindingsVector, dependencies, attachments, depth);
-	}
+		std::vector<vk::PushConstantRange> pushConstants {
+			vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(ZPassConstants))
+		};
+
+		zPass = std::make_unique<GraphicsPipeline>(instance, cache->cache(), vsCode.code(), fsCode.code(), bindingsVector, attachments, depth, pushConstants);
+	});
 
 	return zPass;
 }
 
 const std::unique_ptr<GraphicsPipeline> &PipelineCollection::draw_pass() {
-	if (drawPass == nullptr) {
-		auto vsPath = base_path / "shaders" / "full.vert.spv";
-		auto fsPath = base_path / "shaders" / "full.frag.spv";
+	std::call_once(drawPassOnce, [this]() {
+		ShaderCode vsCode("full.vert.spv", shader_override_path);
+		ShaderCode fsCode("full.frag.spv", shader_override_path);
 
 		std::vector<vk::DescriptorSetLayoutBinding> bindings0{
-				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1,
-											   vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-											   nullptr),
-				vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eUniformBuffer, 1,
+				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1,
 											   vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
 											   nullptr)
 		};
 
-		std::vector<vk::DescriptorSetLayoutBinding> bindings1{
-				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1,
-											   vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-											   nullptr),
-				vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1,
-												vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-												nullptr)
-		};
-
-		std::vector<vk::DescriptorSetLayoutBinding> bindings2 {
-				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1,
-											   vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-											   nullptr),
-				vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 4,
-											   vk::ShaderStageFlagBits::eFragment, nullptr)
-		};
+		//Drawn straight into the swapchain image when possible, so the color target has its format either way
+		std::vector<vk::Format> color_formats { output_format };
+		std::optional<vk::Format> depth_format = PIPELINE_DEPTH_FORMAT;
 
-		std::vector<GraphicsPipelineAttachment> color_formats { GraphicsPipelineAttachment(PIPELINE_COLOR_FORMAT, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal) };
-		std::optional<GraphicsPipelineAttachment> depth_format = GraphicsPipelineAttachment(PIPELINE_DEPTH_FORMAT, vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ bindings0 }};
 
-		std::vector<vk::SubpassDependency> dependencies {
-				/*{VK_SUBPASS_EXTERNAL, 0, vk::PipelineStageFlagBits::eColorAttachmentOutput,
-				 vk::PipelineStageFlagBits::eColorAttachmentOutput, {},
-				 vk::AccessFlagBits::eColorAttachmentWrite}*/
+		std::vector<vk::PushConstantRange> pushConstants {
+			vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(DrawConstants))
 		};
 
-		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ bindings0, bindings1, bindings2 }};
-
-		drawPass = std::make_unique<GraphicsPipeline>(instance, vsPath, fsPath, bindingsVector, dependencies, color_formats, depth_format);
-	}
+		//Set 1 holds the material textures
+		drawPass = std::make_unique<GraphicsPipeline>(instance, cache->cache(), vsCode.code(), fsCode.code(), bindingsVector, color_formats, depth_format, pushConstants,
+													  std::vector<vk::DescriptorSetLayout>{ materialLayout });
+	});
 
 	return drawPass;
 }
 
-const std::unique_ptr<ComputePipeline> &PipelineCollection::copy_pass() {
-	if(copyPass == nullptr) {
-		auto shaderPath = base_path / "shaders" / "copy.comp.spv";
+const std::unique_ptr<GraphicsPipeline> &PipelineCollection::present_pass() {
+	std::call_once(presentPassOnce, [this]() {
+		ShaderCode vsCode("present.vert.spv", shader_override_path);
+		ShaderCode fsCode("present.frag.spv", shader_override_path);
 
 		std::vector<vk::DescriptorSetLayoutBinding> bindings {
-				vk::DescriptorSetLayoutBinding( 0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
-				vk::DescriptorSetLayoutBinding( 1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute)
+				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, nullptr)
 		};
 
-		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ bindings  }};
+		std::vector<vk::Format> color_formats { output_format };
+		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ bindings }};
+
+		presentPass = std::make_unique<GraphicsPipeline>(instance, cache->cache(), vsCode.code(), fsCode.code(), bindingsVector, color_formats, std::nullopt);
+	});
+
+	return presentPass;
+}
+
+std::unique_ptr<ComputePipeline> PipelineCollection::create_copy_pass(glm::uvec2 shape) {
+	ShaderCode shaderCode("copy.comp.spv", shader_override_path);
+
+	std::vector<vk::DescriptorSetLayoutBinding> bindings {
+			vk::DescriptorSetLayoutBinding( 0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding( 1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+
+	std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ bindings  }};
+
+	return std::make_unique<ComputePipeline>(instance, cache->cache(), shaderCode.code(), bindingsVector, std::vector<vk::PushConstantRange>{}, std::vector<uint32_t>{ shape.x, shape.y });
+}
+
+std::unique_ptr<ComputePipeline> PipelineCollection::create_downsample_pass(glm::uvec2 shape) {
+	//With a max reduction sampler one fetch replaces the four loads of each texel
+	ShaderCode shaderCode(reduction_sampler ? "downsample_minmax.comp.spv" : "downsample.comp.spv", shader_override_path);
+	auto sourceType = reduction_sampler ? vk::DescriptorType::eCombinedImageSampler : vk::DescriptorType::eStorageImage;
 
-		copyPass = std::make_unique<ComputePipeline>(instance, shaderPath, bindingsVector);
+	std::vector<vk::DescriptorSetLayoutBinding> bindings{
+			vk::DescriptorSetLayoutBinding(0, sourceType, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+
+	std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{bindings}};
+
+	return std::make_unique<ComputePipeline>(instance, cache->cache(), shaderCode.code(), bindingsVector, std::vector<vk::PushConstantRange>{}, std::vector<uint32_t>{ shape.x, shape.y });
+}
+
+std::unique_ptr<ComputePipeline> PipelineCollection::create_query_pass(glm::uvec2 shape) {
+	ShaderCode shaderCode("query.comp.spv", shader_override_path);
+
+	//Views are passed by device address, only the HZB is left in a set
+	std::vector<vk::DescriptorSetLayoutBinding> queryBindings {
+		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute)
+	};
+
+	std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ queryBindings }};
+
+	std::vector<vk::PushConstantRange> pushConstants {
+		vk::PushConstantRange( vk::ShaderStageFlagBits::eCompute, 0, sizeof(QueryConstants))
+	};
+
+	//The query appends visible instances with subgroup ballots, one atomic per batch per subgroup
+	const auto& subgroup = instance->subgroup_properties();
+	auto required = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eBallot;
+	if (!(subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) || (subgroup.supportedOperations & required) != required) {
+		throw std::runtime_error("Subgroup ballot operations are not supported in compute shaders");
 	}
 
-	return copyPass;
+	return std::make_unique<ComputePipeline>(instance, cache->cache(), shaderCode.code(), bindingsVector, pushConstants,
+											 std::vector<uint32_t>{ shape.x, shape.y, reduction_sampler ? 1U : 0U });
 }
 
-const std::unique_ptr<ComputePipeline> &PipelineCollection::downsample_pass() {
-	if (downsamplePass == nullptr) {
-		auto shaderPath = base_path / "shaders" / "downsample.comp.spv";
+std::vector<glm::uvec2> PipelineCollection::image_candidates() const {
+	auto limits = instance->physical_device().getProperties().limits;
 
-		std::vector<vk::DescriptorSetLayoutBinding> bindings{
-				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute),
-				vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute)
-		};
+	std::vector<glm::uvec2> candidates;
+	for(auto shape : { glm::uvec2(8, 4), glm::uvec2(8, 8), glm::uvec2(16, 8), glm::uvec2(16, 16), glm::uvec2(32, 4), glm::uvec2(32, 8) }) {
+		if (shape.x * shape.y <= limits.maxComputeWorkGroupInvocations && shape.x <= limits.maxComputeWorkGroupSize[0] && shape.y <= limits.maxComputeWorkGroupSize[1]) {
+			candidates.push_back(shape);
+		}
+	}
+
+	return candidates;
+}
+
+std::vector<glm::uvec2> PipelineCollection::query_candidates() const {
+	auto limits = instance->physical_device().getProperties().limits;
+	auto subgroupSize = instance->subgroup_properties().subgroupSize;
+
+	//Whole subgroups only
+	std::vector<glm::uvec2> candidates;
+	for(uint32_t subgroups = 1; subgroups <= 8; subgroups *= 2) {
+		auto size = subgroupSize * subgroups;
+		if (size >= 32 && size <= limits.maxComputeWorkGroupInvocations && size <= limits.maxComputeWorkGroupSize[0]) {
+			candidates.emplace_back(size, 1);
+		}
+	}
 
-		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{bindings}};
+	if (candidates.empty()) {
+		candidates.emplace_back(subgroupSize, 1);
+	}
 
-		downsamplePass = std::make_unique<ComputePipeline>(instance, shaderPath, bindingsVector);
+	return candidates;
+}
+
+const std::unique_ptr<ComputePipeline>& PipelineCollection::compute_variant(std::string_view kernel, glm::uvec2 shape) {
+	ComputeVariant* variant;
+	{
+		std::lock_guard lock(variantsMutex);
+		auto& slot = variants[{ kernel, shape.x, shape.y }];
+		if (slot == nullptr) {
+			slot = std::make_unique<ComputeVariant>();
+		}
+		variant = slot.get();
 	}
 
-	return downsamplePass;
+	//Built outside of the lock, so different variants still compile concurrently
+	std::call_once(variant->once, [this, variant, kernel, shape]() {
+		if (kernel == TUNED_KERNEL_COPY) {
+			variant->pipeline = create_copy_pass(shape);
+		} else if (kernel == TUNED_KERNEL_DOWNSAMPLE) {
+			variant->pipeline = create_downsample_pass(shape);
+		} else if (kernel == TUNED_KERNEL_QUERY) {
+			variant->pipeline = create_query_pass(shape);
+		} else {
+			throw std::runtime_error("Unknown compute kernel " + std::string(kernel));
+		}
+	});
+
+	return variant->pipeline;
+}
+
+const std::unique_ptr<ComputePipeline> &PipelineCollection::copy_pass() {
+	return compute_variant(TUNED_KERNEL_COPY, tuner->shape(TUNED_KERNEL_COPY, image_candidates()));
+}
+
+const std::unique_ptr<ComputePipeline> &PipelineCollection::downsample_pass() {
+	return compute_variant(TUNED_KERNEL_DOWNSAMPLE, tuner->shape(TUNED_KERNEL_DOWNSAMPLE, image_candidates()));
 }
 
 const std::unique_ptr<ComputePipeline> &PipelineCollection::query_pass() {
-	if (queryPass == nullptr) {
-		auto shaderPath = base_path / "shaders" / "query.comp.spv";
+	return compute_variant(TUNED_KERNEL_QUERY, tuner->shape(TUNED_KERNEL_QUERY, query_candidates()));
+}
+
+const std::unique_ptr<ComputePipeline> &PipelineCollection::commands_pass() {
+	std::call_once(commandsPassOnce, [this]() {
+		ShaderCode shaderCode("commands.comp.spv", shader_override_path);
+
+		//Every buffer comes in through push constants
+		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector;
 
-		std::vector<vk::DescriptorSetLayoutBinding> matricesBindings {
-			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+		std::vector<vk::PushConstantRange> pushConstants {
+			vk::PushConstantRange( vk::ShaderStageFlagBits::eCompute, 0, sizeof(CommandsConstants))
 		};
 
-		std::vector<vk::DescriptorSetLayoutBinding> instanceBindings {
-			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
-			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+		commandsPass = std::make_unique<ComputePipeline>(instance, cache->cache(), shaderCode.code(), bindingsVector, pushConstants);
+	});
+
+	return commandsPass;
+}
+
+const std::unique_ptr<ComputePipeline> &PipelineCollection::compact_pass() {
+	std::call_once(compactPassOnce, [this]() {
+		ShaderCode shaderCode("compact.comp.spv", shader_override_path);
+
+		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector;
+
+		std::vector<vk::PushConstantRange> pushConstants {
+			vk::PushConstantRange( vk::ShaderStageFlagBits::eCompute, 0, sizeof(CompactConstants))
 		};
 
-		std::vector<vk::DescriptorSetLayoutBinding> queryBindings {
-			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
-			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		compactPass = std::make_unique<ComputePipeline>(instance, cache->cache(), shaderCode.code(), bindingsVector, pushConstants);
+	});
+
+	return compactPass;
+}
+
+const std::unique_ptr<ComputePipeline> &PipelineCollection::bvh_pass() {
+	std::call_once(bvhPassOnce, [this]() {
+		ShaderCode shaderCode("bvh.comp.spv", shader_override_path);
+
+		//Samples the HZB like the query pass does
+		std::vector<vk::DescriptorSetLayoutBinding> bvhBindings {
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute)
 		};
 
-		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ matricesBindings, instanceBindings, queryBindings }};
+		std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindingsVector = {{ bvhBindings }};
 
 		std::vector<vk::PushConstantRange> pushConstants {
-			vk::PushConstantRange( vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t))
+			vk::PushConstantRange( vk::ShaderStageFlagBits::eCompute, 0, sizeof(BVHConstants))
 		};
 
-		queryPass = std::make_unique<ComputePipeline>(instance, shaderPath, bindingsVector, pushConstants);
+		//Levels are dispatched indirectly and sized on the GPU, so the workgroup size is fixed rather than tuned
+		bvhPass = std::make_unique<ComputePipeline>(instance, cache->cache(), shaderCode.code(), bindingsVector, pushConstants,
+													std::vector<uint32_t>{ 64, 1, reduction_sampler ? 1U : 0U });
+	});
+
+	return bvhPass;
+}
+
+void PipelineCollection::prewarm(ThreadPool& pool) {
+	std::lock_guard lock(prewarmMutex);
+
+	//Each job goes through the regular accessor, so a frame that needs a pipeline before its job
+	//has run simply builds it itself, and one that needs it while it is being built waits on that one only
+	prewarmJobs.push_back(pool.submit([this]() { z_pass(); }));
+	prewarmJobs.push_back(pool.submit([this]() { draw_pass(); }));
+	prewarmJobs.push_back(pool.submit([this]() { copy_pass(); }));
+	prewarmJobs.push_back(pool.submit([this]() { downsample_pass(); }));
+	prewarmJobs.push_back(pool.submit([this]() { query_pass(); }));
+	prewarmJobs.push_back(pool.submit([this]() { commands_pass(); }));
+	prewarmJobs.push_back(pool.submit([this]() { compact_pass(); }));
+	prewarmJobs.push_back(pool.submit([this]() { bvh_pass(); }));
+}
+
+void PipelineCollection::wait_prewarm() {
+	std::lock_guard lock(prewarmMutex);
+
+	for(auto& job : prewarmJobs) {
+		job.get();
+	}
+	prewarmJobs.clear();
+}
+
+PipelineCollection::~PipelineCollection() {
+	std::lock_guard lock(prewarmMutex);
+
+	//Jobs reference this collection, make sure none are still running
+	for(auto& job : prewarmJobs) {
+		try {
+			job.get();
+		} catch (const std::exception& e) {
+			std::cerr << "[PipelineCollection] Pre-warm failed: " << e.what() << std::endl;
+		}
 	}
+	prewarmJobs.clear();
 
-	return queryPass;
+	instance->device().destroyDescriptorSetLayout(materialLayout);
 }
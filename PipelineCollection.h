@@ -4,29 +4,120 @@
 #include "GraphicsPipeline.h"
 #include "ComputePipeline.h"
 #include "Instance.h"
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include "GlobalTypes.h"
+#include "WorkgroupTuner.h"
 #include <memory>
 #include <filesystem>
+#include <optional>
+#include <mutex>
+#include <future>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <string_view>
 
 #define PIPELINE_DEPTH_FORMAT vk::Format::eD32Sfloat
 #define PIPELINE_COLOR_FORMAT vk::Format::eR8G8B8A8Unorm
+// Upper bound of the bindless material texture array, lowered to what the device supports
+#define PIPELINE_MATERIAL_TEXTURES 4096U
+
+// Kernels with a tuned workgroup shape, FrameData uses the same names for their GPU timer regions
+#define TUNED_KERNEL_COPY "copy"
+#define TUNED_KERNEL_DOWNSAMPLE "downsample"
+#define TUNED_KERNEL_QUERY "query"
 
 class PipelineCollection {
 private:
 	std::shared_ptr<Instance> instance;
-	std::filesystem::path base_path;
+	std::shared_ptr<PipelineCache> cache;
+	std::optional<std::filesystem::path> shader_override_path;
+	// Format of the swapchain images the frame ends up in
+	vk::Format output_format;
+	// The HZB is built and queried through a max reduction sampler
+	bool reduction_sampler;
+	// Bindless texture array of the draw pass, shared with the MaterialLibrary that fills it
+	vk::DescriptorSetLayout materialLayout;
+	uint32_t material_textures;
 	std::unique_ptr<GraphicsPipeline> zPass;
 	std::unique_ptr<GraphicsPipeline> drawPass;
-	std::unique_ptr<ComputePipeline> copyPass;
-	std::unique_ptr<ComputePipeline> downsamplePass;
-	std::unique_ptr<ComputePipeline> queryPass;
+	std::unique_ptr<GraphicsPipeline> presentPass;
+	std::unique_ptr<ComputePipeline> commandsPass;
+	std::unique_ptr<ComputePipeline> compactPass;
+	std::unique_ptr<ComputePipeline> bvhPass;
+
+	std::once_flag zPassOnce;
+	std::once_flag drawPassOnce;
+	std::once_flag presentPassOnce;
+	std::once_flag commandsPassOnce;
+
+	//Kernels with a tuned workgroup shape get one pipeline per shape, built on first use
+	struct ComputeVariant {
+		std::once_flag once;
+		std::unique_ptr<ComputePipeline> pipeline;
+	};
+	std::unique_ptr<WorkgroupTuner> tuner;
+	std::mutex variantsMutex;
+	std::map<std::tuple<std::string_view, uint32_t, uint32_t>, std::unique_ptr<ComputeVariant>> variants;
+
+	const std::unique_ptr<ComputePipeline>& compute_variant(std::string_view kernel, glm::uvec2 shape);
+	std::unique_ptr<ComputePipeline> create_copy_pass(glm::uvec2 shape);
+	std::unique_ptr<ComputePipeline> create_downsample_pass(glm::uvec2 shape);
+	std::unique_ptr<ComputePipeline> create_query_pass(glm::uvec2 shape);
+	std::vector<glm::uvec2> image_candidates() const;
+	std::vector<glm::uvec2> query_candidates() const;
+	std::once_flag compactPassOnce;
+	std::once_flag bvhPassOnce;
+
+	std::mutex prewarmMutex;
+	std::vector<std::future<void>> prewarmJobs;
 public:
-	PipelineCollection(std::shared_ptr<Instance> inst, std::filesystem::path basePath);
+	// 'hzbReduction' is only honored when Instance::minmax_reduction_supported()
+	PipelineCollection(std::shared_ptr<Instance> inst, std::shared_ptr<PipelineCache> pipelineCache, vk::Format outputFormat, bool hzbReduction,
+					   std::optional<std::filesystem::path> shaderOverridePath = std::nullopt);
+	~PipelineCollection();
+
+	// Compiles every pipeline concurrently on 'pool'. The accessors below stay valid at any time:
+	// they only block until the pipeline they return has been built.
+	void prewarm(ThreadPool& pool);
+	// Blocks until every pre-warm job has finished, rethrowing the first failure
+	void wait_prewarm();
 
 	const std::unique_ptr<GraphicsPipeline>& z_pass();
 	const std::unique_ptr<GraphicsPipeline>& draw_pass();
+	// Writes the drawn frame into the swapchain image, only used when the frame is not drawn there directly
+	const std::unique_ptr<GraphicsPipeline>& present_pass();
+	// These return the variant for the shape currently picked by the tuner
 	const std::unique_ptr<ComputePipeline>& copy_pass();
 	const std::unique_ptr<ComputePipeline>& downsample_pass();
 	const std::unique_ptr<ComputePipeline>& query_pass();
+	const std::unique_ptr<ComputePipeline>& commands_pass();
+	const std::unique_ptr<ComputePipeline>& compact_pass();
+	// Tests one level of the instance hierarchy against the views and the HZB
+	const std::unique_ptr<ComputePipeline>& bvh_pass();
+
+	inline vk::Format color_format() const {
+		return output_format;
+	}
+
+	// Downsample and query expect a max reduction sampler on their HZB bindings, see Sampler
+	inline bool hzb_reduction() const {
+		return reduction_sampler;
+	}
+
+	// Set 1 of the draw pass, for MaterialLibrary
+	inline const vk::DescriptorSetLayout& material_set_layout() const {
+		return materialLayout;
+	}
+
+	inline uint32_t material_texture_capacity() const {
+		return material_textures;
+	}
+
+	inline WorkgroupTuner& workgroup_tuner() {
+		return *tuner;
+	}
 };
 
 #endif //VKOCCLUSIONTEST_PIPELINECOLLECTION_H
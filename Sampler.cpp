@@ -4,10 +4,18 @@
 
 #include "Sampler.h"
 
-Sampler::Sampler(std::shared_ptr<Instance> inst, vk::Filter minFilter, vk::Filter magFilter, vk::SamplerMipmapMode mipMode) : instance(std::move(inst)) {
+Sampler::Sampler(std::shared_ptr<Instance> inst, vk::Filter minFilter, vk::Filter magFilter, vk::SamplerMipmapMode mipMode,
+				 vk::SamplerReductionMode reduction, float maxLod) : instance(std::move(inst)) {
 	vk::SamplerCreateInfo info({}, magFilter, minFilter, mipMode, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge);
 	info.unnormalizedCoordinates = false;
 	info.compareEnable = false;
+	info.maxLod = maxLod;
+
+	//Min and max make a linear filter return the min or max of its footprint instead of a weighted average
+	vk::SamplerReductionModeCreateInfo reductionInfo(reduction);
+	if (reduction != vk::SamplerReductionMode::eWeightedAverage) {
+		info.setPNext(&reductionInfo);
+	}
 
 	_sampler = instance->device().createSampler(info);
 }
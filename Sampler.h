@@ -10,7 +10,10 @@ private:
 	std::shared_ptr<Instance> instance;
 	vk::Sampler _sampler;
 public:
-	Sampler(std::shared_ptr<Instance> inst, vk::Filter minFilter, vk::Filter magFilter, vk::SamplerMipmapMode mode);
+	// Reductions other than eWeightedAverage need Instance::minmax_reduction_supported().
+	// Levels past 'maxLod' are never sampled, VK_LOD_CLAMP_NONE reaches every level of the view
+	Sampler(std::shared_ptr<Instance> inst, vk::Filter minFilter, vk::Filter magFilter, vk::SamplerMipmapMode mode,
+			vk::SamplerReductionMode reduction = vk::SamplerReductionMode::eWeightedAverage, float maxLod = 0.0f);
 	~Sampler();
 
 	inline const vk::Sampler& sampler() const {
@@ -1,76 +1,138 @@
 #include "Scene.h"
 #include <stdexcept>
 #include <unordered_map>
+#include <cstring>
+#include <algorithm>
 
 #define MAKE_BATCH_ID(matId, meshId) ((static_cast<uint64_t>(matId) << 32) + meshId)
 
-Scene::Scene(std::shared_ptr<Instance> inst, size_t maxVertexAmount, size_t maxObjectAmount) : instance(std::move(inst)), _maxObjects(maxObjectAmount), _nextObjectId(0) {
+Scene::Scene(std::shared_ptr<Instance> inst, size_t maxVertexAmount, size_t maxObjectAmount, const vk::DescriptorSetLayout& materialLayout, uint32_t maxTextureAmount,
+			 size_t maxMaterialAmount) : instance(std::move(inst)),
+	_layoutVersion(0), _version(0), _instancesUpToDate(false), _maxObjects(maxObjectAmount), _nextObjectId(0) {
 	_meshes = std::make_unique<MeshBuffer>(instance, maxVertexAmount);
+	_materials = std::make_unique<MaterialLibrary>(instance, materialLayout, maxTextureAmount, maxMaterialAmount);
 }
 
-void Scene::fill_buffers(const std::unique_ptr<Buffer> &instanceBuffer, const std::unique_ptr<Buffer> &batchBuffer,
-						 const std::unique_ptr<Buffer> &drawBuffer, const std::unique_ptr<Buffer> &clearBuffer) {
-	if (!_instancesUpToDate) {
-		sort_instances();
+//Coalesces entries changed after 'sinceVersion' into ranges, close gaps are uploaded too
+static std::vector<InstanceRange> changed_ranges(const std::vector<uint64_t>& versions, uint64_t sinceVersion) {
+	std::vector<InstanceRange> ranges;
+	for(uint32_t i = 0; i < versions.size(); i++) {
+		if (versions[i] <= sinceVersion) {
+			continue;
+		}
+
+		if (!ranges.empty() && i - (ranges.back().first + ranges.back().count) <= SCENE_UPLOAD_MERGE_GAP) {
+			ranges.back().count = i - ranges.back().first + 1;
+		} else {
+			ranges.push_back({ i, 1 });
+		}
 	}
 
-	if (batchBuffer != nullptr)
+	return ranges;
+}
+
+SceneUpload Scene::fill_buffers(const std::unique_ptr<Buffer> &instanceBuffer, const std::unique_ptr<Buffer> &batchBuffer,
+								const std::unique_ptr<Buffer>& nodeBuffer, const std::unique_ptr<Buffer>& leafBuffer, uint64_t sinceVersion) {
+	refresh_instances();
+
+	SceneUpload upload { {}, _layoutVersion > sinceVersion, {}, _bvh.build_version() > sinceVersion, 0 };
+
+	if (upload.batches && batchBuffer != nullptr)
 	{
 		auto mapping = batchBuffer->map_t<DrawBatch>();
 		mapping.fill_from(_batches);
+		upload.bytes += _batches.size() * sizeof(DrawBatch);
 	}
 
 	if (instanceBuffer != nullptr)
 	{
-		auto mapping = instanceBuffer->map_t<ObjectInstance>();
-		mapping.fill_from(_instances);
+		upload.instances = changed_ranges(_instanceVersions, sinceVersion);
+
+		if (!upload.instances.empty()) {
+			auto mapping = instanceBuffer->map_t<ObjectInstance>();
+			if (mapping.size() < _instances.size()) {
+				throw std::runtime_error("Not enough space for all instances in instanceBuffer");
+			}
+
+			for(const auto& range : upload.instances) {
+				std::memcpy(mapping.data() + range.first, _instances.data() + range.first, range.count * sizeof(ObjectInstance));
+				upload.bytes += range.count * sizeof(ObjectInstance);
+			}
+		}
 	}
 
-	if (drawBuffer != nullptr)
+	if (nodeBuffer != nullptr)
 	{
-		auto mapping = drawBuffer->map_t<VkDrawIndirectCommand>();
-		if (mapping.size() < _batches.size()) {
-			throw std::runtime_error("Not enough space for all draw batches in drawBuffer");
+		//Refits touch a leaf and its ancestors, one range per level at worst
+		upload.nodes = changed_ranges(_bvh.node_versions(), sinceVersion);
+
+		if (!upload.nodes.empty()) {
+			auto mapping = nodeBuffer->map_t<BVHNode>();
+			if (mapping.size() < _bvh.nodes().size()) {
+				throw std::runtime_error("Not enough space for all nodes in nodeBuffer");
+			}
+
+			for(const auto& range : upload.nodes) {
+				std::memcpy(mapping.data() + range.first, _bvh.nodes().data() + range.first, range.count * sizeof(BVHNode));
+				upload.bytes += range.count * sizeof(BVHNode);
+			}
 		}
+	}
 
-		uint32_t total = 0;
-		for(int i = 0; i < _batches.size(); i++) {
-			const auto& batch = _batches[i];
-			const auto& mesh = _meshes->meshes()[batch.meshId];
+	if (upload.leaves && leafBuffer != nullptr && !_bvh.leaf_instances().empty())
+	{
+		auto mapping = leafBuffer->map_t<uint32_t>();
+		mapping.fill_from(_bvh.leaf_instances());
+		upload.bytes += _bvh.leaf_instances().size() * sizeof(uint32_t);
+	}
 
-			mapping[i].firstInstance = total;
-			mapping[i].instanceCount = batch.amount;
-			mapping[i].firstVertex = mesh.vertexOffset;
-			mapping[i].vertexCount = mesh.vertexAmount;
+	return upload;
+}
 
-			total += batch.amount;
-		}
-	}
+InstanceBounds Scene::instance_bounds(const glm::mat4& model, uint32_t meshId) const {
+	const auto& mesh = _meshes->meshes()[meshId];
 
-	if (clearBuffer != nullptr) {
-		auto mapping = clearBuffer->map_t<VkDrawIndirectCommand>();
-		if (mapping.size() < _batches.size()) {
-			throw std::runtime_error("Not enough space for all draw batches in drawBuffer");
-		}
+	//Box around the transformed mesh box, mesh extents are its full size
+	auto center = glm::vec3(model * glm::vec4(mesh.bbCenter, 1.0f));
+	auto half = glm::mat3(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2]))) * (0.5f * mesh.bbExtents);
+	return { center - half, center + half };
+}
 
-		uint32_t total = 0;
-		for(int i = 0; i < _batches.size(); i++) {
-			const auto& batch = _batches[i];
-			const auto& mesh = _meshes->meshes()[batch.meshId];
+void Scene::refresh_instances() {
+	if (!_instancesUpToDate) {
+		sort_instances();
+		return;
+	}
 
-			mapping[i].firstInstance = total;
-			mapping[i].instanceCount = 0;
-			mapping[i].firstVertex = mesh.vertexOffset;
-			mapping[i].vertexCount = mesh.vertexAmount;
+	//Objects are modified in place through get_object(), so look for transforms that moved since the last refresh
+	bool changed = false;
+	std::vector<uint32_t> movedSlots;
+	for(size_t i = 0; i < _objects.size(); i++) {
+		auto& obj = _objects[i];
+		if (obj.transform.revision() == _objectRevisions[i]) {
+			continue;
+		}
 
-			total += batch.amount;
+		if (!changed) {
+			_version++;
+			changed = true;
 		}
+
+		auto slot = _objectSlots[i];
+		setInstanceModel(_instances[slot], obj.transform.model());
+		_instanceBounds[slot] = instance_bounds(obj.transform.model(), obj.meshId);
+		_instanceVersions[slot] = _version;
+		_objectRevisions[i] = obj.transform.revision();
+		movedSlots.push_back(slot);
 	}
+
+	_bvh.refit(_instanceBounds, movedSlots, _version);
 }
 
 void Scene::sort_instances() {
+	//Material major: materials are bound once per frame, but neighbouring draws then read the same material and textures
 	std::sort(_batches.begin(), _batches.end(), [](const DrawBatch& left, const DrawBatch& right) {
-		return left.materialId < right.materialId || left.meshId < right.meshId;
+		return left.materialId < right.materialId || (left.materialId == right.materialId && left.meshId < right.meshId);
 	});
 
 	std::unordered_map<uint64_t, uint32_t> positions;
@@ -81,26 +143,41 @@ void Scene::sort_instances() {
 	for(auto& b : _batches) {
 		auto batchId = MAKE_BATCH_ID(b.materialId, b.meshId);
 		positions[batchId] = total;
+		b.firstInstance = total;
 		ids[batchId] = id++;
 
 		total += b.amount;
 	}
 
+	//Every object must own exactly one place in a batch, or the instances below are written out of bounds
+	if (total != _objects.size()) {
+		throw std::runtime_error("Draw batches do not match the scene objects");
+	}
+
 	_instances.clear();
 	_instances.resize(_objects.size());
-	for(auto& obj : _objects) {
+	_instanceBounds.resize(_objects.size());
+	_objectSlots.resize(_objects.size());
+	_objectRevisions.resize(_objects.size());
+	for(size_t i = 0; i < _objects.size(); i++) {
+		auto& obj = _objects[i];
 		auto batchId = MAKE_BATCH_ID(obj.materialId, obj.meshId);
 		auto idx = positions[batchId];
 		auto batchIndex = ids[batchId];
 
-		_instances[idx].model = obj.transform.model();
-		_instances[idx].materialMeshBatchId = glm::ivec4(obj.materialId, obj.meshId, batchIndex, 0);
-		_instances[idx].bbCenter = glm::vec4(_meshes->meshes()[obj.meshId].bbCenter, 1.0);
-		_instances[idx].bbSize = glm::vec4(_meshes->meshes()[obj.meshId].bbExtents, 0.0);
+		_instances[idx] = makeInstance(obj.transform.model(), obj.meshId, obj.materialId, batchIndex);
+		_instanceBounds[idx] = instance_bounds(obj.transform.model(), obj.meshId);
 
 		positions[batchId] = idx + 1;
+		_objectSlots[i] = idx;
+		_objectRevisions[i] = obj.transform.revision();
 	}
 
+	//Every slot may hold a different instance now
+	_layoutVersion = ++_version;
+	_instanceVersions.assign(_instances.size(), _version);
+	_bvh.build(_instanceBounds, _version);
+
 	_instancesUpToDate = true;
 }
 
@@ -125,11 +202,18 @@ uint32_t Scene::addObject(uint32_t meshId, uint32_t materialId) {
 	return obj.objectId;
 }
 
-Object& Scene::get_object(uint32_t id) {
-	auto it = std::find_if(_objects.begin(), _objects.end(), [id](const Object& obj) {
-		return obj.objectId == id;
+//Ids are handed out in increasing order and removal keeps the order, so objects stay sorted by id
+static std::vector<Object>::iterator find_object(std::vector<Object>& objects, uint32_t id) {
+	auto it = std::lower_bound(objects.begin(), objects.end(), id, [](const Object& obj, uint32_t id) {
+		return obj.objectId < id;
 	});
 
+	return it != objects.end() && it->objectId == id ? it : objects.end();
+}
+
+Object& Scene::get_object(uint32_t id) {
+	auto it = find_object(_objects, id);
+
 	if (it == _objects.end()) {
 		throw std::runtime_error("Could not find object");
 	}
@@ -138,11 +222,17 @@ Object& Scene::get_object(uint32_t id) {
 }
 
 bool Scene::remove_object(uint32_t id) {
-	auto it = std::find_if(_objects.begin(), _objects.end(), [id](const Object& obj) {
-		return obj.objectId == id;
-	});
+	auto it = find_object(_objects, id);
 
 	if (it != _objects.end()) {
+		//Emptied batches are dropped, so they get no draw command at all
+		auto batch = std::find_if(_batches.begin(), _batches.end(), [&](const DrawBatch& b) {
+			return b.meshId == it->meshId && b.materialId == it->materialId;
+		});
+		if (batch != _batches.end() && --batch->amount == 0) {
+			_batches.erase(batch);
+		}
+
 		_objects.erase(it);
 		_instancesUpToDate = false;
 		return true;
@@ -5,8 +5,13 @@
 #include "Mesh.h"
 #include "Buffer.h"
 #include "GlobalTypes.h"
+#include "InstanceBVH.h"
+#include "MaterialLibrary.h"
 #include <vector>
 
+// Instances separated by at most this many clean ones are uploaded as a single range
+#define SCENE_UPLOAD_MERGE_GAP 4
+
 struct Object {
 	uint32_t objectId;
 	uint32_t meshId;
@@ -14,34 +19,83 @@ struct Object {
 	Transform transform;
 };
 
+struct InstanceRange {
+	uint32_t first;
+	uint32_t count;
+};
+
+// What fill_buffers wrote, so the same regions can be copied to device local buffers
+struct SceneUpload {
+	std::vector<InstanceRange> instances;
+	// The batch table was rewritten as well
+	bool batches;
+	std::vector<InstanceRange> nodes;
+	// The hierarchy was rebuilt, its leaf instances were rewritten
+	bool leaves;
+	size_t bytes;
+};
 
 class Scene {
 private:
 	std::shared_ptr<Instance> instance;
 	std::unique_ptr<MeshBuffer> _meshes;
+	std::unique_ptr<MaterialLibrary> _materials;
 	std::vector<Object> _objects;
 	std::vector<DrawBatch> _batches;
 
 	std::vector<ObjectInstance> _instances;
+	// World space bounds per instance slot, the hierarchy is built over them
+	std::vector<InstanceBounds> _instanceBounds;
+	InstanceBVH _bvh;
+	// Scene version each instance slot last changed at, and the version the slots were last rearranged at
+	std::vector<uint64_t> _instanceVersions;
+	uint64_t _layoutVersion;
+	uint64_t _version;
+	// Per object: instance slot and last uploaded transform revision
+	std::vector<uint32_t> _objectSlots;
+	std::vector<uint32_t> _objectRevisions;
 
 	bool _instancesUpToDate;
 	size_t _maxObjects;
 	uint32_t _nextObjectId;
 
 	void sort_instances();
+	InstanceBounds instance_bounds(const glm::mat4& model, uint32_t meshId) const;
 public:
-	Scene(std::shared_ptr<Instance> inst, size_t maxVertexAmount, size_t maxObjectAmount);
+	// 'materialLayout' and 'maxTextureAmount' come from PipelineCollection, see MaterialLibrary
+	Scene(std::shared_ptr<Instance> inst, size_t maxVertexAmount, size_t maxObjectAmount, const vk::DescriptorSetLayout& materialLayout, uint32_t maxTextureAmount,
+		  size_t maxMaterialAmount = MATERIAL_TABLE_DEFAULT_CAPACITY);
 
-	void fill_buffers(const std::unique_ptr<Buffer>& instanceBuffer, const std::unique_ptr<Buffer>& batchBuffer, const std::unique_ptr<Buffer>& drawBuffer, const std::unique_ptr<Buffer>& clearBuffer);
+	// Writes everything that changed after 'sinceVersion' (0 writes everything), then use version() as the next 'sinceVersion'
+	// Draw commands are built from these tables on the GPU. Null buffers are skipped
+	SceneUpload fill_buffers(const std::unique_ptr<Buffer>& instanceBuffer, const std::unique_ptr<Buffer>& batchBuffer,
+							 const std::unique_ptr<Buffer>& nodeBuffer, const std::unique_ptr<Buffer>& leafBuffer, uint64_t sinceVersion = 0);
+	// Applies added, removed and moved objects to the instances and the hierarchy, fill_buffers does so as well.
+	// Call it before sizing buffers for bvh()
+	void refresh_instances();
 
 	uint32_t addObject(uint32_t meshId, uint32_t materialId);
 	Object& get_object(uint32_t id);
 	bool remove_object(uint32_t id);
 
+	inline uint64_t version() const {
+		return _version;
+	}
+
+	// Version instance slots were last rearranged at, slots may hold other objects after it changes
+	inline uint64_t layout_version() const {
+		return _layoutVersion;
+	}
+
 	inline const size_t batches_amount() const {
 		return _batches.size();
 	}
 
+	// Over the instance slots, up to date after refresh_instances()
+	inline const InstanceBVH& bvh() const {
+		return _bvh;
+	}
+
 	inline const std::vector<Object>& objects() const {
 		return _objects;
 	}
@@ -53,6 +107,11 @@ public:
 	inline const std::unique_ptr<MeshBuffer>& meshes() const {
 		return _meshes;
 	}
+
+	// Indexed by Object::materialId
+	inline const std::unique_ptr<MaterialLibrary>& materials() const {
+		return _materials;
+	}
 };
 
 #endif //VKOCCLUSIONTEST_SCENE_H
@@ -1,20 +1,46 @@
 #include "Swapchain.h"
 #include <SDL2/SDL_vulkan.h>
 #include <glm/glm.hpp>
+#include <algorithm>
 
-Swapchain::Swapchain(SDL_Window* window, std::shared_ptr<Instance> instance) : instance(instance) {
+Swapchain::Swapchain(SDL_Window* window, std::shared_ptr<Instance> instance, vk::PresentModeKHR presentMode) : instance(instance),
+	_requested_present_mode(presentMode), _present_mode(vk::PresentModeKHR::eFifo) {
 	if(!SDL_Vulkan_CreateSurface(window, static_cast<VkInstance>(instance->instance()), reinterpret_cast<VkSurfaceKHR*>(&_surface))) {
 		throw std::runtime_error("Failed to create Vulkan surface");
 	}
 }
 
-bool Swapchain::create_swapchain(glm::ivec2 sz) {
+vk::PresentModeKHR Swapchain::select_present_mode() const {
+	auto supported = instance->physical_device().getSurfacePresentModesKHR(_surface);
+
+	//Fall back to the closest mode in terms of tearing and latency, FIFO is always available
+	std::vector<vk::PresentModeKHR> candidates { _requested_present_mode };
+	switch(_requested_present_mode) {
+		case vk::PresentModeKHR::eMailbox:
+			candidates.push_back(vk::PresentModeKHR::eImmediate);
+			break;
+		case vk::PresentModeKHR::eImmediate:
+			candidates.push_back(vk::PresentModeKHR::eMailbox);
+			candidates.push_back(vk::PresentModeKHR::eFifoRelaxed);
+			break;
+		default:
+			break;
+	}
+
+	for(auto mode : candidates) {
+		if (std::find(supported.begin(), supported.end(), mode) != supported.end()) {
+			return mode;
+		}
+	}
+
+	return vk::PresentModeKHR::eFifo;
+}
+
+bool Swapchain::create_swapchain(glm::ivec2 sz, DeletionQueue* retired) {
 	if (sz == _size) {
 		return true;
 	}
 
-	destroy_swapchain();
-
 	auto surfaceCapabilities = instance->physical_device().getSurfaceCapabilitiesKHR(_surface);
 	auto surfaceFormats = instance->physical_device().getSurfaceFormatsKHR(_surface);
 
@@ -34,10 +60,18 @@ bool Swapchain::create_swapchain(glm::ivec2 sz) {
 	sz.x = glm::clamp(sz.x, (int) surfaceCapabilities.minImageExtent.width, (int) surfaceCapabilities.maxImageExtent.width);
 	sz.y = glm::clamp(sz.y, (int) surfaceCapabilities.minImageExtent.height, (int) surfaceCapabilities.maxImageExtent.height);
 
-	vk::SwapchainCreateInfoKHR swapchainCreateInfo({}, _surface, surfaceCapabilities.minImageCount, _surface_format.format, _surface_format.colorSpace,
+	_present_mode = select_present_mode();
+
+	//Mailbox needs a spare image to always have one to render into
+	auto imageCount = surfaceCapabilities.minImageCount + (_present_mode == vk::PresentModeKHR::eMailbox ? 1 : 0);
+	if (surfaceCapabilities.maxImageCount > 0) {
+		imageCount = glm::min(imageCount, surfaceCapabilities.maxImageCount);
+	}
+
+	vk::SwapchainCreateInfoKHR swapchainCreateInfo({}, _surface, imageCount, _surface_format.format, _surface_format.colorSpace,
 												   vk::Extent2D(sz.x, sz.y), 1, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eTransferDst,
 												   {}, nullptr, surfaceCapabilities.currentTransform,
-												   vk::CompositeAlphaFlagBitsKHR::eOpaque, vk::PresentModeKHR::eFifo, true);
+												   vk::CompositeAlphaFlagBitsKHR::eOpaque, _present_mode, true, _swapchain);
 
 	std::vector<uint32_t> queueFamilyIndices { (uint32_t) instance->graphics_queue_index() };
 	if (instance->graphics_queue_index() != instance->present_queue_index()) {
@@ -48,9 +82,28 @@ bool Swapchain::create_swapchain(glm::ivec2 sz) {
 	}
 	swapchainCreateInfo.setQueueFamilyIndices(queueFamilyIndices);
 
+	//Passing the old swapchain lets the presentation engine hand its resources over, it only has to be destroyed once unused
+	auto oldSwapchain = _swapchain;
+	auto oldViews = std::move(_image_views);
 	_swapchain = instance->device().createSwapchainKHR(swapchainCreateInfo);
 	auto swapchainImages = instance->device().getSwapchainImagesKHR(_swapchain);
 
+	if (oldSwapchain) {
+		auto destroy = [device = instance->device(), oldSwapchain, oldViews]() {
+			for(auto& view : oldViews) {
+				device.destroyImageView(view);
+			}
+			device.destroySwapchainKHR(oldSwapchain);
+		};
+
+		if (retired) {
+			retired->push(std::move(destroy));
+		} else {
+			instance->wait_idle();
+			destroy();
+		}
+	}
+
 	std::vector<vk::ImageView> imageViews;
 
 	for(const auto& img : swapchainImages) {
@@ -59,6 +112,7 @@ bool Swapchain::create_swapchain(glm::ivec2 sz) {
 		imageViews.push_back(instance->device().createImageView(imgViewCreateInfo));
 	}
 
+	_images = swapchainImages;
 	_image_views = imageViews;
 	_size = sz;
 	return true;
@@ -75,8 +129,11 @@ bool Swapchain::destroy_swapchain() {
 		instance->device().destroyImageView(img);
 	}
 	_image_views.clear();
+	_images.clear();
 
 	instance->device().destroySwapchainKHR(_swapchain);
+	_swapchain = nullptr;
+	_size = {};
 
 	return true;
 }
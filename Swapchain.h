@@ -2,6 +2,7 @@
 #define VKOCCLUSIONTEST_SWAPCHAIN_H
 
 #include "Instance.h"
+#include "DeletionQueue.h"
 #include <memory>
 #include <vector>
 #include <glm/glm.hpp>
@@ -12,12 +13,19 @@ private:
 	vk::SurfaceKHR _surface;
 	vk::SwapchainKHR _swapchain;
 	vk::SurfaceFormatKHR _surface_format;
+	std::vector<vk::Image> _images;
 	std::vector<vk::ImageView> _image_views;
 	glm::ivec2 _size;
+	vk::PresentModeKHR _requested_present_mode;
+	vk::PresentModeKHR _present_mode;
+
+	vk::PresentModeKHR select_present_mode() const;
 public:
-	Swapchain(SDL_Window* window, std::shared_ptr<Instance> instance);
+	Swapchain(SDL_Window* window, std::shared_ptr<Instance> instance, vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo);
 
-	bool create_swapchain(glm::ivec2 size);
+	// Recreates the swapchain from the current one. Its images may still be in use by frames in flight: when 'retired' is given
+	// it is destroyed through that queue, otherwise the device is waited on first
+	bool create_swapchain(glm::ivec2 size, DeletionQueue* retired = nullptr);
 	bool destroy_swapchain();
 
 	~Swapchain();
@@ -30,6 +38,10 @@ public:
 		return _swapchain;
 	}
 
+	inline const std::vector<vk::Image>& images() const& {
+		return _images;
+	}
+
 	inline const std::vector<vk::ImageView>& image_views() const& {
 		return _image_views;
 	}
@@ -41,6 +53,11 @@ public:
 	inline glm::ivec2 size() const {
 		return _size;
 	}
+
+	// The mode actually in use, which may differ from the requested one if the surface does not support it
+	inline vk::PresentModeKHR present_mode() const {
+		return _present_mode;
+	}
 };
 
 
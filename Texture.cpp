@@ -4,7 +4,8 @@
 #include <iostream>
 #include "Buffer.h"
 
-Texture::Texture(std::shared_ptr<Instance> inst, vk::Format format, vk::ImageUsageFlags flags, glm::ivec2 sz, uint32_t levels) : instance(std::move(inst)), _format(format), _size(sz), _flags(flags) {
+Texture::Texture(std::shared_ptr<Instance> inst, vk::Format format, vk::ImageUsageFlags flags, glm::ivec2 sz, uint32_t levels, TextureMemory memory) :
+	instance(std::move(inst)), _format(format), _flags(flags), _owns_memory(memory == TextureMemory::eDedicated), _size(sz) {
 
 	if (levels == TEXTURE_LEVELS_AUTO) {
 		int width = _size.x, height = _size.y;
@@ -22,6 +23,10 @@ Texture::Texture(std::shared_ptr<Instance> inst, vk::Format format, vk::ImageUsa
 
 	_image = instance->device().createImage(imageInfo);
 
+	if (!_owns_memory) {
+		return;
+	}
+
 	auto memoryRequirements = instance->device().getImageMemoryRequirements(_image);
 
 	auto any = false;
@@ -54,7 +59,22 @@ Texture::Texture(std::shared_ptr<Instance> inst, vk::Format format, vk::ImageUsa
 
 Texture::~Texture() {
 	instance->device().destroyImage(_image);
-	instance->device().freeMemory(_memory);
+	if (_owns_memory) {
+		instance->device().freeMemory(_memory);
+	}
+}
+
+vk::MemoryRequirements Texture::memory_requirements() const {
+	return instance->device().getImageMemoryRequirements(_image);
+}
+
+void Texture::bind_memory(const vk::DeviceMemory& memory, vk::DeviceSize offset) {
+	if (_owns_memory || _memory) {
+		throw std::runtime_error("Texture memory is already bound");
+	}
+
+	_memory = memory;
+	instance->device().bindImageMemory(_image, _memory, offset);
 }
 
 bool Texture::fill_from_file(const vk::CommandBuffer& cmd, const std::filesystem::path &path, uint32_t level, vk::ImageLayout targetLayout) {
@@ -72,11 +92,13 @@ bool Texture::fill_from_file(const vk::CommandBuffer& cmd, const std::filesystem
 		return false;
 	}
 
-	auto tmpBuffer = Buffer(instance, fileWidth * fileHeight * fileChannels, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	//Decoded to four channels whatever the file holds, through the shared transfer buffer since the copy runs after this returns
+	auto dataSize = static_cast<size_t>(fileWidth) * fileHeight * 4;
+	const auto& tmpBuffer = Instance::get_transfer_buffer(instance, dataSize);
 
 	{
-		auto map = tmpBuffer.map();
-		std::memcpy(static_cast<void*>(map), (void*)pixels, tmpBuffer.size());
+		auto map = tmpBuffer->map();
+		std::memcpy(static_cast<void*>(map), (void*)pixels, dataSize);
 	}
 
 	stbi_image_free(pixels);
@@ -87,7 +109,46 @@ bool Texture::fill_from_file(const vk::CommandBuffer& cmd, const std::filesystem
 	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, transfer_barrier);
 
 	vk::BufferImageCopy imageCopy(0, 0, 0, { vk::ImageAspectFlagBits::eColor, level, 0, 1}, { fileWidth, fileHeight, 1});
-	cmd.copyBufferToImage(static_cast<vk::Buffer>(tmpBuffer), _image, vk::ImageLayout::eTransferDstOptimal, imageCopy);
+	cmd.copyBufferToImage(tmpBuffer->buffer(), _image, vk::ImageLayout::eTransferDstOptimal, imageCopy);
+
+	vk::ImageMemoryBarrier readable_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, targetLayout, {}, {}, _image, subResourceRange);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, readable_barrier);
+
+	return true;
+}
+
+bool Texture::fill_from_texture_file(const vk::CommandBuffer& cmd, const TextureFile& file, vk::ImageLayout targetLayout) {
+	if (file.format() != _format || file.size() != _size || file.levels().size() < _levels) {
+		return false;
+	}
+
+	//All levels go through the transfer buffer at once, one region each
+	size_t dataSize = 0;
+	for(uint32_t level = 0; level < _levels; level++) {
+		dataSize += file.levels()[level].size;
+	}
+
+	const auto& buffer = Instance::get_transfer_buffer(instance, dataSize);
+	std::vector<vk::BufferImageCopy> regions;
+	{
+		auto map = buffer->map();
+		size_t offset = 0;
+		auto levelSize = _size;
+		for(uint32_t level = 0; level < _levels; level++) {
+			std::memcpy(static_cast<uint8_t*>(static_cast<void*>(map)) + offset, file.level_data(level), file.levels()[level].size);
+			regions.emplace_back(offset, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1), vk::Offset3D(0, 0, 0),
+								 vk::Extent3D(levelSize.x, levelSize.y, 1));
+
+			offset += file.levels()[level].size;
+			levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+		}
+	}
+
+	vk::ImageSubresourceRange subResourceRange( vk::ImageAspectFlagBits::eColor, 0, _levels, 0, 1);
+	vk::ImageMemoryBarrier transfer_barrier(vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, {}, {}, _image, subResourceRange);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, transfer_barrier);
+
+	cmd.copyBufferToImage(buffer->buffer(), _image, vk::ImageLayout::eTransferDstOptimal, regions);
 
 	vk::ImageMemoryBarrier readable_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, targetLayout, {}, {}, _image, subResourceRange);
 	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, readable_barrier);
@@ -97,8 +158,6 @@ bool Texture::fill_from_file(const vk::CommandBuffer& cmd, const std::filesystem
 
 bool Texture::fill_from_data(const vk::CommandBuffer &cmd, const std::vector<uint8_t> &data, uint32_t level,
 							 uint32_t channels, vk::ImageLayout targetLayout) {
-	level = glm::max(level, 1U);
-
 	auto targetWidth = _size.x, targetHeight = _size.y;
 	for(int i = 0; i < level; i++) {
 		targetWidth = glm::max(targetWidth / 2, 1);
@@ -109,10 +168,13 @@ bool Texture::fill_from_data(const vk::CommandBuffer &cmd, const std::vector<uin
 		return false;
 	}
 
-	auto buffer = Buffer(instance, targetWidth * targetHeight * channels, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	//The copy runs after this returns, so the data goes through the shared transfer buffer like mesh uploads.
+	//Other uploads through it have to finish before the next one is recorded
+	auto dataSize = targetWidth * targetHeight * channels;
+	const auto& buffer = Instance::get_transfer_buffer(instance, dataSize);
 	{
-		auto map = buffer.map();
-		std::memcpy(static_cast<void*>(map), data.data(), buffer.size());
+		auto map = buffer->map();
+		std::memcpy(static_cast<void*>(map), data.data(), dataSize);
 	}
 
 	vk::ImageSubresourceRange subResourceRange( vk::ImageAspectFlagBits::eColor, level, 1, 0, 1);
@@ -121,7 +183,7 @@ bool Texture::fill_from_data(const vk::CommandBuffer &cmd, const std::vector<uin
 	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, transfer_barrier);
 
 	vk::BufferImageCopy imageCopy(0, 0, 0, { vk::ImageAspectFlagBits::eColor, level, 0, 1}, { targetWidth, targetHeight, 1});
-	cmd.copyBufferToImage(static_cast<vk::Buffer>(buffer), _image, vk::ImageLayout::eTransferDstOptimal, imageCopy);
+	cmd.copyBufferToImage(buffer->buffer(), _image, vk::ImageLayout::eTransferDstOptimal, imageCopy);
 
 	vk::ImageMemoryBarrier readable_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, targetLayout, {}, {}, _image, subResourceRange);
 	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, readable_barrier);
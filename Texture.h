@@ -3,12 +3,20 @@
 
 #include <vulkan/vulkan.hpp>
 #include "Instance.h"
+#include "TextureFile.h"
 #include <memory>
 #include <glm/glm.hpp>
 #include <filesystem>
 
 #define TEXTURE_LEVELS_AUTO 0
 
+enum class TextureMemory {
+	// The texture allocates and owns its memory
+	eDedicated,
+	// Memory is bound later through bind_memory, for instance shared with other textures by a FrameGraph
+	eExternal
+};
+
 class Texture {
 private:
 	std::shared_ptr<Instance> instance;
@@ -16,13 +24,21 @@ private:
 	vk::Format _format;
 	vk::ImageUsageFlags _flags;
 	vk::DeviceMemory _memory;
+	bool _owns_memory;
 	glm::ivec2 _size;
 	uint32_t _levels;
 public:
-	Texture(std::shared_ptr<Instance> instance, vk::Format format, vk::ImageUsageFlags flags, glm::ivec2 sz, uint32_t levels = TEXTURE_LEVELS_AUTO);
+	Texture(std::shared_ptr<Instance> instance, vk::Format format, vk::ImageUsageFlags flags, glm::ivec2 sz, uint32_t levels = TEXTURE_LEVELS_AUTO,
+			TextureMemory memory = TextureMemory::eDedicated);
 	~Texture();
 
+	vk::MemoryRequirements memory_requirements() const;
+	// Only for TextureMemory::eExternal textures, once. 'memory' must outlive the texture
+	void bind_memory(const vk::DeviceMemory& memory, vk::DeviceSize offset);
+
 	bool fill_from_file(const vk::CommandBuffer& cmd, const std::filesystem::path& path, uint32_t level, vk::ImageLayout targetLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+	// Copies the levels as stored, block compressed ones included. The file needs this texture's format and size, and at least its levels
+	bool fill_from_texture_file(const vk::CommandBuffer& cmd, const TextureFile& file, vk::ImageLayout targetLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
 	bool fill_from_data(const vk::CommandBuffer& cmd, const std::vector<uint8_t>& data, uint32_t level, uint32_t channels, vk::ImageLayout targetLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
 
 	inline const vk::Image& image() const {
@@ -37,6 +53,10 @@ public:
 		return _size;
 	}
 
+	inline vk::ImageUsageFlags usage() const {
+		return _flags;
+	}
+
 	inline vk::Format format() const {
 		return _format;
 	}
@@ -0,0 +1,172 @@
+// Offline converter from images to KTX2 files with a full mip chain, in the block compressed formats
+// vkOcclusionTest uploads as they are:
+//   textureConverter <input image> <output.ktx2> [--format=bc1|bc3|bc5|rgba8] [--srgb] [--no-mips]
+// Without --format, images with alpha become BC3 and the others BC1. BC5 keeps red and green, for normal maps.
+// BC7 files from other tools are loaded too, but not written here: a BC7 encoder is well beyond this converter
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "TextureFile.h"
+#include "BlockCompression.h"
+
+enum class OutputFormat {
+	eAuto,
+	eBC1,
+	eBC3,
+	eBC5,
+	eRGBA8
+};
+
+static float to_linear(uint8_t value) {
+	float v = value / 255.0f;
+	return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t from_linear(float value) {
+	float v = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	return static_cast<uint8_t>(std::lround(glm::clamp(v, 0.0f, 1.0f) * 255.0f));
+}
+
+//Box filter over 2x2 texels, the last row or column is reused for odd sizes. sRGB color is averaged in linear space
+static std::vector<uint8_t> downsample(const std::vector<uint8_t>& rgba, glm::ivec2 size, bool srgb) {
+	auto next = glm::max(size / 2, glm::ivec2(1));
+	std::vector<uint8_t> out(static_cast<size_t>(next.x) * next.y * 4);
+
+	for(int y = 0; y < next.y; y++) {
+		for(int x = 0; x < next.x; x++) {
+			for(int c = 0; c < 4; c++) {
+				float sum = 0.0f;
+				for(int sy = 0; sy < 2; sy++) {
+					for(int sx = 0; sx < 2; sx++) {
+						auto px = std::min(x * 2 + sx, size.x - 1);
+						auto py = std::min(y * 2 + sy, size.y - 1);
+						auto value = rgba[(static_cast<size_t>(py) * size.x + px) * 4 + c];
+						sum += srgb && c < 3 ? to_linear(value) : value / 255.0f;
+					}
+				}
+
+				auto average = sum / 4.0f;
+				out[(static_cast<size_t>(y) * next.x + x) * 4 + c] = srgb && c < 3 ? from_linear(average) : static_cast<uint8_t>(std::lround(average * 255.0f));
+			}
+		}
+	}
+
+	return out;
+}
+
+static vk::Format vulkan_format(OutputFormat format, bool srgb) {
+	switch(format) {
+		case OutputFormat::eBC1:
+			return srgb ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc1RgbUnormBlock;
+		case OutputFormat::eBC3:
+			return srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+		case OutputFormat::eBC5:
+			//Two channel data is never color
+			return vk::Format::eBc5UnormBlock;
+		default:
+			return srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+	}
+}
+
+static std::vector<uint8_t> encode(OutputFormat format, const std::vector<uint8_t>& rgba, glm::ivec2 size) {
+	switch(format) {
+		case OutputFormat::eBC1:
+			return compress_bc1(rgba.data(), size);
+		case OutputFormat::eBC3:
+			return compress_bc3(rgba.data(), size);
+		case OutputFormat::eBC5:
+			return compress_bc5(rgba.data(), size);
+		default:
+			return rgba;
+	}
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::string_view> paths;
+	auto format = OutputFormat::eAuto;
+	bool srgb = false;
+	bool mips = true;
+
+	for(int i = 1; i < argc; i++) {
+		std::string_view arg(argv[i]);
+
+		if (arg == "--format=bc1") {
+			format = OutputFormat::eBC1;
+		} else if (arg == "--format=bc3") {
+			format = OutputFormat::eBC3;
+		} else if (arg == "--format=bc5") {
+			format = OutputFormat::eBC5;
+		} else if (arg == "--format=rgba8") {
+			format = OutputFormat::eRGBA8;
+		} else if (arg == "--srgb") {
+			srgb = true;
+		} else if (arg == "--no-mips") {
+			mips = false;
+		} else if (!arg.starts_with("--")) {
+			paths.push_back(arg);
+		} else {
+			std::cerr << "[TextureConverter] Unknown argument " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	if (paths.size() != 2) {
+		std::cerr << "Usage: textureConverter <input image> <output.ktx2> [--format=bc1|bc3|bc5|rgba8] [--srgb] [--no-mips]" << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::string input(paths[0]);
+
+	int width = 0, height = 0, channels = 0;
+	stbi_uc* pixels = stbi_load(input.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (pixels == nullptr) {
+		std::cerr << "[TextureConverter] Failed to read " << input << ": " << stbi_failure_reason() << std::endl;
+		return 1;
+	}
+
+	glm::ivec2 size(width, height);
+	std::vector<uint8_t> level(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(pixels);
+
+	if (format == OutputFormat::eAuto) {
+		format = channels == 2 || channels == 4 ? OutputFormat::eBC3 : OutputFormat::eBC1;
+	}
+
+	//Every level down to 1x1 is encoded from the one above it, not from the compressed data
+	std::vector<std::vector<uint8_t>> levels;
+	auto levelSize = size;
+	while(true) {
+		levels.push_back(encode(format, level, levelSize));
+		if (!mips || (levelSize.x == 1 && levelSize.y == 1)) {
+			break;
+		}
+
+		level = downsample(level, levelSize, srgb);
+		levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+	}
+
+	try {
+		TextureFile file(vulkan_format(format, srgb), size, levels);
+		file.write_ktx2(std::string(paths[1]));
+
+		auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+		//A full RGBA8 mip chain takes about 4/3 of its first level
+		auto rgba8Size = texture_level_size(vk::Format::eR8G8B8A8Unorm, size) * (mips ? 4.0 / 3.0 : 1.0);
+		std::cout << "[TextureConverter] " << input << ": " << width << "x" << height << " " << vk::to_string(file.format()) << ", " << levels.size()
+				  << " levels, " << file.levels_size() / 1024 << " KiB (" << 100.0 * file.levels_size() / rgba8Size << "% of RGBA8) in "
+				  << time.count() << "ms" << std::endl;
+	} catch (const std::exception& e) {
+		std::cerr << "[TextureConverter] Failed to write " << paths[1] << ": " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,398 @@
+#include "TextureFile.h"
+#include <fstream>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <array>
+#include <algorithm>
+#include <string>
+#include <climits>
+
+static const std::array<uint8_t, 12> KTX2_IDENTIFIER { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+// Identifier, nine header fields and the index of the data format descriptor, key/values and supercompression data
+#define KTX2_HEADER_SIZE (12 + 9 * sizeof(uint32_t) + 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t))
+#define KTX2_LEVEL_INDEX_ENTRY_SIZE (3 * sizeof(uint64_t))
+
+#define DDS_MAGIC 0x20534444u
+// Magic and DDS_HEADER, DDS_HEADER_DXT10 follows when the pixel format says DX10
+#define DDS_HEADER_SIZE (4 + 124)
+#define DDS_HEADER_DXT10_SIZE 20
+#define DDS_PIXEL_FORMAT_OFFSET (4 + 72)
+#define DDS_PIXEL_FORMAT_FOURCC 0x4u
+#define DDS_PIXEL_FORMAT_RGB 0x40u
+#define DDS_CAPS2_CUBEMAP 0x200u
+#define DDS_CAPS2_VOLUME 0x200000u
+#define DDS_DIMENSION_TEXTURE2D 3u
+#define DDS_MISC_TEXTURECUBE 0x4u
+
+static constexpr uint32_t fourcc(const char (&code)[5]) {
+	return uint32_t(uint8_t(code[0])) | uint32_t(uint8_t(code[1])) << 8 | uint32_t(uint8_t(code[2])) << 16 | uint32_t(uint8_t(code[3])) << 24;
+}
+
+template<typename T>
+static T read_value(const std::vector<uint8_t>& data, size_t offset) {
+	if (offset + sizeof(T) > data.size()) {
+		throw std::runtime_error("Texture file is truncated");
+	}
+
+	T value;
+	std::memcpy(&value, data.data() + offset, sizeof(T));
+	return value;
+}
+
+template<typename T>
+static void write_value(std::vector<uint8_t>& data, size_t offset, T value) {
+	std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+static glm::ivec2 level_size(glm::ivec2 size, size_t level) {
+	for(size_t i = 0; i < level; i++) {
+		size = glm::max(size / 2, glm::ivec2(1));
+	}
+
+	return size;
+}
+
+//Sizes have to fit glm::ivec2, and the levels the mip chain of that size, or images can't be created from them
+static void check_dimensions(uint32_t width, uint32_t height, uint32_t levels) {
+	if (width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX) {
+		throw std::runtime_error("Texture file size " + std::to_string(width) + "x" + std::to_string(height) + " is not supported");
+	}
+
+	if (levels > texture_max_levels(glm::ivec2(width, height))) {
+		throw std::runtime_error("Texture file has more levels than its size allows");
+	}
+}
+
+uint32_t texture_max_levels(glm::ivec2 size) {
+	uint32_t levels = 1;
+	for(auto side = std::max(size.x, size.y); side > 1; side /= 2) {
+		levels++;
+	}
+
+	return levels;
+}
+
+TextureBlockInfo texture_block_info(vk::Format format) {
+	switch(format) {
+		case vk::Format::eR8G8B8A8Unorm:
+		case vk::Format::eR8G8B8A8Srgb:
+			return { 1, 4 };
+		case vk::Format::eBc1RgbUnormBlock:
+		case vk::Format::eBc1RgbSrgbBlock:
+		case vk::Format::eBc1RgbaUnormBlock:
+		case vk::Format::eBc1RgbaSrgbBlock:
+			return { 4, 8 };
+		case vk::Format::eBc3UnormBlock:
+		case vk::Format::eBc3SrgbBlock:
+		case vk::Format::eBc5UnormBlock:
+		case vk::Format::eBc5SnormBlock:
+		case vk::Format::eBc7UnormBlock:
+		case vk::Format::eBc7SrgbBlock:
+			return { 4, 16 };
+		default:
+			throw std::runtime_error("Unsupported texture file format " + vk::to_string(format));
+	}
+}
+
+size_t texture_level_size(vk::Format format, glm::ivec2 size) {
+	auto block = texture_block_info(format);
+	auto blocksX = (static_cast<size_t>(size.x) + block.dimension - 1) / block.dimension;
+	auto blocksY = (static_cast<size_t>(size.y) + block.dimension - 1) / block.dimension;
+	return blocksX * blocksY * block.bytes;
+}
+
+TextureFile::TextureFile(vk::Format format, glm::ivec2 size, const std::vector<std::vector<uint8_t>>& levels) : _format(format), _size(size) {
+	if (size.x <= 0 || size.y <= 0 || levels.size() > texture_max_levels(size)) {
+		throw std::runtime_error("Texture levels do not match the texture size");
+	}
+
+	for(size_t i = 0; i < levels.size(); i++) {
+		if (levels[i].size() != texture_level_size(format, level_size(size, i))) {
+			throw std::runtime_error("Texture level size does not match its format");
+		}
+
+		_levels.push_back({ _data.size(), levels[i].size() });
+		_data.insert(_data.end(), levels[i].begin(), levels[i].end());
+	}
+}
+
+size_t TextureFile::levels_size() const {
+	return std::accumulate(_levels.begin(), _levels.end(), size_t(0), [](size_t total, const TextureLevel& l) { return total + l.size; });
+}
+
+TextureFile TextureFile::load(const std::filesystem::path& path) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		throw std::runtime_error("Failed to open texture file");
+	}
+
+	//Read as a whole, levels are then only pointed at
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+	if (data.size() >= KTX2_IDENTIFIER.size() && std::equal(KTX2_IDENTIFIER.begin(), KTX2_IDENTIFIER.end(), data.begin())) {
+		return parse_ktx2(std::move(data));
+	}
+
+	if (data.size() >= sizeof(uint32_t) && read_value<uint32_t>(data, 0) == DDS_MAGIC) {
+		return parse_dds(std::move(data));
+	}
+
+	throw std::runtime_error("Not a KTX2 or DDS file");
+}
+
+TextureFile TextureFile::parse_ktx2(std::vector<uint8_t> data) {
+	auto vkFormat = read_value<uint32_t>(data, 12);
+	auto width = read_value<uint32_t>(data, 20);
+	auto height = read_value<uint32_t>(data, 24);
+	auto depth = read_value<uint32_t>(data, 28);
+	auto layers = read_value<uint32_t>(data, 32);
+	auto faces = read_value<uint32_t>(data, 36);
+	auto levels = std::max(read_value<uint32_t>(data, 40), 1u);
+	auto supercompression = read_value<uint32_t>(data, 44);
+
+	if (supercompression != 0) {
+		throw std::runtime_error("Supercompressed KTX2 files are not supported");
+	}
+
+	if (depth > 1 || layers > 1 || faces != 1) {
+		throw std::runtime_error("Only single 2D textures are supported");
+	}
+	check_dimensions(width, height, levels);
+
+	TextureFile texture;
+	texture._format = static_cast<vk::Format>(vkFormat);
+	texture._size = glm::ivec2(width, height);
+
+	//The level index lists level 0 first, whatever the order of the data
+	for(uint32_t i = 0; i < levels; i++) {
+		auto entry = KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+		auto offset = read_value<uint64_t>(data, entry);
+		auto size = read_value<uint64_t>(data, entry + sizeof(uint64_t));
+
+		//Compared without adding to the offset, which the file could make wrap around
+		if (size != texture_level_size(texture._format, level_size(texture._size, i)) || offset > data.size() || size > data.size() - offset) {
+			throw std::runtime_error("KTX2 level does not match its format and size");
+		}
+
+		texture._levels.push_back({ static_cast<size_t>(offset), static_cast<size_t>(size) });
+	}
+
+	texture._data = std::move(data);
+	return texture;
+}
+
+static vk::Format dxgi_format(uint32_t dxgi) {
+	switch(dxgi) {
+		case 28: return vk::Format::eR8G8B8A8Unorm;
+		case 29: return vk::Format::eR8G8B8A8Srgb;
+		case 71: return vk::Format::eBc1RgbaUnormBlock;
+		case 72: return vk::Format::eBc1RgbaSrgbBlock;
+		case 77: return vk::Format::eBc3UnormBlock;
+		case 78: return vk::Format::eBc3SrgbBlock;
+		case 83: return vk::Format::eBc5UnormBlock;
+		case 84: return vk::Format::eBc5SnormBlock;
+		case 98: return vk::Format::eBc7UnormBlock;
+		case 99: return vk::Format::eBc7SrgbBlock;
+		default:
+			throw std::runtime_error("Unsupported DXGI format " + std::to_string(dxgi));
+	}
+}
+
+TextureFile TextureFile::parse_dds(std::vector<uint8_t> data) {
+	auto height = read_value<uint32_t>(data, 12);
+	auto width = read_value<uint32_t>(data, 16);
+	auto levels = std::max(read_value<uint32_t>(data, 28), 1u);
+	auto pixelFlags = read_value<uint32_t>(data, DDS_PIXEL_FORMAT_OFFSET + 4);
+	auto pixelFourCC = read_value<uint32_t>(data, DDS_PIXEL_FORMAT_OFFSET + 8);
+	auto caps2 = read_value<uint32_t>(data, 4 + 108);
+
+	if ((caps2 & (DDS_CAPS2_CUBEMAP | DDS_CAPS2_VOLUME)) != 0) {
+		throw std::runtime_error("Only single 2D textures are supported");
+	}
+	check_dimensions(width, height, levels);
+
+	TextureFile texture;
+	texture._size = glm::ivec2(width, height);
+	size_t offset = DDS_HEADER_SIZE;
+
+	if ((pixelFlags & DDS_PIXEL_FORMAT_FOURCC) != 0) {
+		switch(pixelFourCC) {
+			case fourcc("DXT1"):
+				texture._format = vk::Format::eBc1RgbaUnormBlock;
+				break;
+			case fourcc("DXT5"):
+				texture._format = vk::Format::eBc3UnormBlock;
+				break;
+			case fourcc("ATI2"):
+			case fourcc("BC5U"):
+				texture._format = vk::Format::eBc5UnormBlock;
+				break;
+			case fourcc("BC5S"):
+				texture._format = vk::Format::eBc5SnormBlock;
+				break;
+			case fourcc("DX10"): {
+				auto dimension = read_value<uint32_t>(data, DDS_HEADER_SIZE + 4);
+				auto misc = read_value<uint32_t>(data, DDS_HEADER_SIZE + 8);
+				auto arraySize = read_value<uint32_t>(data, DDS_HEADER_SIZE + 12);
+				if (dimension != DDS_DIMENSION_TEXTURE2D || (misc & DDS_MISC_TEXTURECUBE) != 0 || arraySize > 1) {
+					throw std::runtime_error("Only single 2D textures are supported");
+				}
+
+				texture._format = dxgi_format(read_value<uint32_t>(data, DDS_HEADER_SIZE));
+				offset += DDS_HEADER_DXT10_SIZE;
+				break;
+			}
+			default:
+				throw std::runtime_error("Unsupported DDS four character code");
+		}
+	} else if ((pixelFlags & DDS_PIXEL_FORMAT_RGB) != 0 && read_value<uint32_t>(data, DDS_PIXEL_FORMAT_OFFSET + 12) == 32 &&
+			   read_value<uint32_t>(data, DDS_PIXEL_FORMAT_OFFSET + 16) == 0x000000FFu && read_value<uint32_t>(data, DDS_PIXEL_FORMAT_OFFSET + 20) == 0x0000FF00u &&
+			   read_value<uint32_t>(data, DDS_PIXEL_FORMAT_OFFSET + 24) == 0x00FF0000u) {
+		texture._format = vk::Format::eR8G8B8A8Unorm;
+	} else {
+		throw std::runtime_error("Unsupported DDS pixel format");
+	}
+
+	//Levels follow each other, level 0 first
+	for(uint32_t i = 0; i < levels; i++) {
+		auto size = texture_level_size(texture._format, level_size(texture._size, i));
+		if (offset > data.size() || size > data.size() - offset) {
+			throw std::runtime_error("Texture file is truncated");
+		}
+
+		texture._levels.push_back({ offset, size });
+		offset += size;
+	}
+
+	texture._data = std::move(data);
+	return texture;
+}
+
+// Basic data format descriptor block of the formats written, KTX2 requires one
+static std::vector<uint32_t> ktx2_data_format_descriptor(vk::Format format) {
+	// Bit offset, bit length and channel id of each sample
+	struct Sample {
+		uint32_t offset;
+		uint32_t length;
+		uint32_t channel;
+	};
+
+	// KHR_DF_MODEL_*, channel ids are per model
+	uint32_t model;
+	std::vector<Sample> samples;
+	bool srgb = false;
+
+	switch(format) {
+		case vk::Format::eR8G8B8A8Srgb:
+			srgb = true;
+			[[fallthrough]];
+		case vk::Format::eR8G8B8A8Unorm:
+			model = 1;
+			samples = { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, 15 } };
+			break;
+		case vk::Format::eBc1RgbSrgbBlock:
+			srgb = true;
+			[[fallthrough]];
+		case vk::Format::eBc1RgbUnormBlock:
+			model = 128;
+			samples = { { 0, 64, 0 } };
+			break;
+		case vk::Format::eBc3SrgbBlock:
+			srgb = true;
+			[[fallthrough]];
+		case vk::Format::eBc3UnormBlock:
+			model = 130;
+			samples = { { 0, 64, 15 }, { 64, 64, 0 } };
+			break;
+		case vk::Format::eBc5UnormBlock:
+			model = 132;
+			samples = { { 0, 64, 0 }, { 64, 64, 1 } };
+			break;
+		case vk::Format::eBc7SrgbBlock:
+			srgb = true;
+			[[fallthrough]];
+		case vk::Format::eBc7UnormBlock:
+			model = 134;
+			samples = { { 0, 128, 0 } };
+			break;
+		default:
+			throw std::runtime_error("Unsupported KTX2 output format " + vk::to_string(format));
+	}
+
+	auto block = texture_block_info(format);
+	auto blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+	std::vector<uint32_t> words {
+		static_cast<uint32_t>(sizeof(uint32_t)) + blockSize,
+		0, // Khronos vendor, basic descriptor type
+		2 | blockSize << 16,
+		model | 1 << 8 | (srgb ? 2u : 1u) << 16, // BT.709 primaries, sRGB or linear transfer
+		(block.dimension - 1) | (block.dimension - 1) << 8,
+		block.bytes,
+		0
+	};
+
+	for(const auto& s : samples) {
+		// Alpha is never sRGB encoded
+		uint32_t linear = srgb && s.channel == 15 ? 0x10 : 0;
+		uint32_t upper = s.length >= 32 ? UINT32_MAX : (1u << s.length) - 1;
+		words.push_back(s.offset | (s.length - 1) << 16 | (s.channel | linear) << 24);
+		words.push_back(0);
+		words.push_back(0);
+		words.push_back(upper);
+	}
+
+	return words;
+}
+
+void TextureFile::write_ktx2(const std::filesystem::path& path) const {
+	auto dfd = ktx2_data_format_descriptor(_format);
+	auto block = texture_block_info(_format);
+	// Levels are aligned to lcm(block size, 4), all block sizes here are powers of two
+	size_t alignment = std::max<size_t>(block.bytes, 4);
+
+	auto levelIndex = KTX2_HEADER_SIZE;
+	auto dfdOffset = levelIndex + _levels.size() * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+	auto dfdSize = dfd.size() * sizeof(uint32_t);
+
+	//Data is stored from the smallest level to the largest
+	std::vector<size_t> offsets(_levels.size());
+	auto end = dfdOffset + dfdSize;
+	for(auto i = _levels.size(); i-- > 0;) {
+		offsets[i] = (end + alignment - 1) / alignment * alignment;
+		end = offsets[i] + _levels[i].size;
+	}
+
+	std::vector<uint8_t> out(end, 0);
+	std::copy(KTX2_IDENTIFIER.begin(), KTX2_IDENTIFIER.end(), out.begin());
+	write_value<uint32_t>(out, 12, static_cast<uint32_t>(_format));
+	write_value<uint32_t>(out, 16, 1); // typeSize
+	write_value<uint32_t>(out, 20, _size.x);
+	write_value<uint32_t>(out, 24, _size.y);
+	write_value<uint32_t>(out, 28, 0); // pixelDepth
+	write_value<uint32_t>(out, 32, 0); // layerCount
+	write_value<uint32_t>(out, 36, 1); // faceCount
+	write_value<uint32_t>(out, 40, static_cast<uint32_t>(_levels.size()));
+	write_value<uint32_t>(out, 44, 0); // supercompressionScheme
+	write_value<uint32_t>(out, 48, static_cast<uint32_t>(dfdOffset));
+	write_value<uint32_t>(out, 52, static_cast<uint32_t>(dfdSize));
+
+	std::memcpy(out.data() + dfdOffset, dfd.data(), dfdSize);
+
+	for(size_t i = 0; i < _levels.size(); i++) {
+		auto entry = levelIndex + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+		write_value<uint64_t>(out, entry, offsets[i]);
+		write_value<uint64_t>(out, entry + sizeof(uint64_t), _levels[i].size);
+		write_value<uint64_t>(out, entry + 2 * sizeof(uint64_t), _levels[i].size);
+		std::memcpy(out.data() + offsets[i], level_data(i), _levels[i].size);
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+	if (!file) {
+		throw std::runtime_error("Failed to write texture file");
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef VKOCCLUSIONTEST_TEXTUREFILE_H
+#define VKOCCLUSIONTEST_TEXTUREFILE_H
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include <filesystem>
+#include <vector>
+#include <cstdint>
+
+// Texels per side and bytes of one block, uncompressed formats have blocks of a single texel
+struct TextureBlockInfo {
+	uint32_t dimension;
+	uint32_t bytes;
+};
+
+// Levels of a full mip chain down to 1x1
+uint32_t texture_max_levels(glm::ivec2 size);
+// Throws for formats texture files are not read or written with
+TextureBlockInfo texture_block_info(vk::Format format);
+// Tightly packed size of one level of 'size' texels
+size_t texture_level_size(vk::Format format, glm::ivec2 size);
+
+inline bool texture_format_block_compressed(vk::Format format) {
+	return texture_block_info(format).dimension > 1;
+}
+
+struct TextureLevel {
+	size_t offset;
+	size_t size;
+};
+
+// Every mip level of a 2D texture as stored in a KTX2 or DDS file. Levels are kept in their final format,
+// block compressed ones included, so they are copied to an image as they are
+class TextureFile {
+private:
+	vk::Format _format;
+	glm::ivec2 _size;
+	// Levels point into it, for a loaded file this is the whole file
+	std::vector<uint8_t> _data;
+	std::vector<TextureLevel> _levels;
+
+	TextureFile() = default;
+	static TextureFile parse_ktx2(std::vector<uint8_t> data);
+	static TextureFile parse_dds(std::vector<uint8_t> data);
+public:
+	// 'levels' are tightly packed, level 0 first
+	TextureFile(vk::Format format, glm::ivec2 size, const std::vector<std::vector<uint8_t>>& levels);
+
+	// KTX2 or DDS, told apart by their magic. Throws for supercompressed files, anything but a single 2D texture and unknown formats
+	static TextureFile load(const std::filesystem::path& path);
+	// KTX2 without supercompression, throws when the file can't be written
+	void write_ktx2(const std::filesystem::path& path) const;
+
+	inline vk::Format format() const {
+		return _format;
+	}
+
+	inline glm::ivec2 size() const {
+		return _size;
+	}
+
+	// Level 0 first
+	inline const std::vector<TextureLevel>& levels() const {
+		return _levels;
+	}
+
+	inline const uint8_t* level_data(size_t level) const {
+		return _data.data() + _levels[level].offset;
+	}
+
+	// Bytes the levels take, once uploaded as they are
+	size_t levels_size() const;
+};
+
+#endif //VKOCCLUSIONTEST_TEXTUREFILE_H
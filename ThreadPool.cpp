@@ -0,0 +1,43 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) : _stopping(false) {
+	threadCount = std::max<size_t>(threadCount, 1);
+
+	_workers.reserve(threadCount);
+	for(size_t i = 0; i < threadCount; i++) {
+		_workers.emplace_back([this]() { worker_loop(); });
+	}
+}
+
+void ThreadPool::worker_loop() {
+	while(true) {
+		std::function<void()> job;
+		{
+			std::unique_lock lock(_mutex);
+			_condition.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+
+			if (_stopping && _jobs.empty()) {
+				return;
+			}
+
+			job = std::move(_jobs.front());
+			_jobs.pop();
+		}
+
+		job();
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(_mutex);
+		_stopping = true;
+	}
+	_condition.notify_all();
+
+	for(auto& w : _workers) {
+		w.join();
+	}
+	_workers.clear();
+}
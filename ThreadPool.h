@@ -0,0 +1,50 @@
+#ifndef VKOCCLUSIONTEST_THREADPOOL_H
+#define VKOCCLUSIONTEST_THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+class ThreadPool {
+private:
+	std::vector<std::thread> _workers;
+	std::queue<std::function<void()>> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _stopping;
+
+	void worker_loop();
+public:
+	explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	~ThreadPool();
+
+	template<typename F>
+	std::future<std::invoke_result_t<F>> submit(F&& job) {
+		using ResultT = std::invoke_result_t<F>;
+
+		auto task = std::make_shared<std::packaged_task<ResultT()>>(std::forward<F>(job));
+		auto future = task->get_future();
+		{
+			std::lock_guard lock(_mutex);
+			_jobs.emplace([task]() { (*task)(); });
+		}
+		_condition.notify_one();
+
+		return future;
+	}
+
+	inline size_t size() const {
+		return _workers.size();
+	}
+};
+
+#endif //VKOCCLUSIONTEST_THREADPOOL_H
@@ -6,6 +6,7 @@ const glm::vec3 &Transform::position() const {
 
 void Transform::position(const glm::vec3 &position) {
 	_upToDate = false;
+	_revision++;
 	_position = position;
 }
 
@@ -15,6 +16,7 @@ const glm::quat &Transform::orientation() const {
 
 void Transform::orientation(const glm::quat &orientation) {
 	_upToDate = false;
+	_revision++;
 	_orientation = orientation;
 }
 
@@ -24,6 +26,7 @@ const glm::vec3 &Transform::scale() const {
 
 void Transform::scale(const glm::vec3 &scale) {
 	_upToDate = false;
+	_revision++;
 	_scale = scale;
 }
 
@@ -37,3 +40,7 @@ glm::mat4 Transform::model() {
 
 	return _model;
 }
+
+uint32_t Transform::revision() const {
+	return _revision;
+}
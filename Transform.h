@@ -12,6 +12,7 @@ private:
 
 	bool _upToDate = true;
 	glm::mat4 _model = glm::mat4(1.0);
+	uint32_t _revision = 0;
 public:
 	const glm::vec3 &position() const;
 	void position(const glm::vec3 &position);
@@ -23,6 +24,9 @@ public:
 	void scale(const glm::vec3 &scale);
 
 	glm::mat4 model();
+
+	// Incremented by every change, used to find out which instances need to be uploaded again
+	uint32_t revision() const;
 };
 
 
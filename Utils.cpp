@@ -1,6 +1,19 @@
 #include "Utils.h"
+#include "EmbeddedShaders.h"
 #include <fstream>
 #include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 std::vector<char> readFile(const std::filesystem::path& path) {
 	if (!exists(path)) {
@@ -20,8 +33,87 @@ std::vector<char> readFile(const std::filesystem::path& path) {
 	return data;
 }
 
-vk::ShaderModule createShaderModule(const std::filesystem::path& path, const vk::Device& device) {
-	auto data = reinterpret_data<char, uint32_t>(readFile(path));
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path &path) : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(nullptr) {
+	_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open " + path.string());
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+		CloseHandle(_file);
+		throw std::runtime_error("Failed to map " + path.string());
+	}
+	_size = (size_t) size.QuadPart;
+
+	_mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping != nullptr) {
+		_data = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	if (_data == nullptr) {
+		if (_mapping != nullptr) {
+			CloseHandle(_mapping);
+		}
+		CloseHandle(_file);
+		throw std::runtime_error("Failed to map " + path.string());
+	}
+}
+
+MappedFile::~MappedFile() {
+	UnmapViewOfFile(_data);
+	CloseHandle(_mapping);
+	CloseHandle(_file);
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path &path) : _data(nullptr), _size(0), _file(-1) {
+	_file = open(path.c_str(), O_RDONLY);
+	if (_file < 0) {
+		throw std::runtime_error("Failed to open " + path.string());
+	}
+
+	struct stat info = {};
+	if (fstat(_file, &info) != 0 || info.st_size == 0) {
+		close(_file);
+		throw std::runtime_error("Failed to map " + path.string());
+	}
+	_size = (size_t) info.st_size;
+
+	_data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _file, 0);
+	if (_data == MAP_FAILED) {
+		close(_file);
+		throw std::runtime_error("Failed to map " + path.string());
+	}
+}
+
+MappedFile::~MappedFile() {
+	munmap(_data, _size);
+	close(_file);
+}
+#endif
+
+ShaderCode::ShaderCode(std::string_view name, const std::optional<std::filesystem::path>& overrideDirectory) {
+	if (overrideDirectory.has_value()) {
+		auto path = overrideDirectory.value() / name;
+		if (exists(path)) {
+			_file = std::make_unique<MappedFile>(path);
+			if (_file->size() % sizeof(uint32_t) != 0) {
+				throw std::runtime_error("Invalid SPIR-V file: " + path.string());
+			}
 
-	return device.createShaderModule({ {}, data });
-}
\ No newline at end of file
+			//Mappings are page aligned, so the words can be handed to the driver in place
+			_code = std::span<const uint32_t>(static_cast<const uint32_t*>(_file->data()), _file->size() / sizeof(uint32_t));
+			return;
+		}
+	}
+
+	_code = find_embedded_shader(name);
+	if (_code.empty()) {
+		throw std::runtime_error("Shader not found: " + std::string(name));
+	}
+}
+
+vk::ShaderModule createShaderModule(std::span<const uint32_t> code, const vk::Device& device) {
+	return device.createShaderModule({ {}, code.size_bytes(), code.data() });
+}
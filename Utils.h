@@ -3,6 +3,10 @@
 
 #include <filesystem>
 #include <vector>
+#include <span>
+#include <optional>
+#include <string_view>
+#include <memory>
 #include <vulkan/vulkan.hpp>
 
 std::vector<char> readFile(const std::filesystem::path& path);
@@ -15,12 +19,53 @@ std::vector<TargetT> reinterpret_data(const std::vector<SourceT>& data) {
 
 	auto nextSize = (data.size() * sizeof(SourceT));
 
-	std::vector<uint32_t> rvl(nextSize / sizeof(TargetT));
+	std::vector<TargetT> rvl(nextSize / sizeof(TargetT));
 	std::memcpy(rvl.data(), data.data(), nextSize);
 
 	return rvl;
 }
 
-vk::ShaderModule createShaderModule(const std::filesystem::path& path, const vk::Device& device);
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+	void* _data;
+	size_t _size;
+#ifdef _WIN32
+	void* _file;
+	void* _mapping;
+#else
+	int _file;
+#endif
+public:
+	explicit MappedFile(const std::filesystem::path& path);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&&) = delete;
+	~MappedFile();
+
+	inline const void* data() const {
+		return _data;
+	}
+
+	inline size_t size() const {
+		return _size;
+	}
+};
+
+// SPIR-V code for a shader module. Points either straight at the module embedded in the executable,
+// or at a memory mapped .spv file when a development override directory is in use.
+class ShaderCode {
+private:
+	std::unique_ptr<MappedFile> _file;
+	std::span<const uint32_t> _code;
+public:
+	ShaderCode(std::string_view name, const std::optional<std::filesystem::path>& overrideDirectory);
+
+	inline std::span<const uint32_t> code() const {
+		return _code;
+	}
+};
+
+vk::ShaderModule createShaderModule(std::span<const uint32_t> code, const vk::Device& device);
 
 #endif //VKOCCLUSIONTEST_UTILS_H
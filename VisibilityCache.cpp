@@ -0,0 +1,59 @@
+#include "VisibilityCache.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "GlobalTypes.h"
+
+VisibilityCache::VisibilityCache(std::shared_ptr<Instance> inst, const VisibilityCacheSettings& settings, size_t capacity) :
+	instance(std::move(inst)), _settings(settings), _capacity(capacity), _frame_index(0), _layout_version(0), _has_reference(false),
+	_cleared(false), _epoch(0), _reset_epoch(0), _reference_view(1.0f), _reference_projection(1.0f) {
+	_settings.agreeFrames = std::clamp(_settings.agreeFrames, 1U, 8U);
+	_settings.refreshPeriod = std::max(_settings.refreshPeriod, 1U);
+
+	//Cleared by the first frame, its epochs are the first ones that are not zero
+	_history = std::make_unique<Buffer>(instance, std::max<size_t>(_capacity, 1) * sizeof(VisibilityHistory),
+										vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferDst,
+										vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
+
+uint32_t VisibilityCache::next_frame() {
+	return _frame_index++;
+}
+
+bool VisibilityCache::take_clear() {
+	return !std::exchange(_cleared, true);
+}
+
+uint32_t VisibilityCache::latch(const glm::mat4& view, const glm::mat4& projection, uint64_t layoutVersion) {
+	//Slots hold other instances after the scene was rearranged, and the first frame has no history at all
+	if (!_has_reference || layoutVersion != _layout_version || projection != _reference_projection) {
+		_has_reference = true;
+		_layout_version = layoutVersion;
+		_reference_view = view;
+		_reference_projection = projection;
+		_epoch++;
+		_reset_epoch++;
+		return VIEW_FLAG_RESET_HISTORY;
+	}
+
+	auto camera = glm::inverse(view);
+	auto reference = glm::inverse(_reference_view);
+	auto distance = glm::length(glm::vec3(camera[3]) - glm::vec3(reference[3]));
+	auto cosine = glm::dot(glm::normalize(glm::vec3(camera[2])), glm::normalize(glm::vec3(reference[2])));
+
+	//Small moves add up against the reference, so results are never reused for a camera more than the threshold away
+	if (distance > _settings.cutDistance || cosine < std::cos(glm::radians(_settings.cutDegrees))) {
+		_reference_view = view;
+		_epoch++;
+		_reset_epoch++;
+		return VIEW_FLAG_RESET_HISTORY;
+	}
+
+	if (distance > _settings.moveThreshold || cosine < std::cos(glm::radians(_settings.turnDegrees))) {
+		_reference_view = view;
+		_epoch++;
+		return VIEW_FLAG_RETEST;
+	}
+
+	return VIEW_FLAG_NONE;
+}
@@ -0,0 +1,83 @@
+#ifndef VKOCCLUSIONTEST_VISIBILITYCACHE_H
+#define VKOCCLUSIONTEST_VISIBILITYCACHE_H
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include <memory>
+#include "Instance.h"
+#include "Buffer.h"
+
+struct VisibilityCacheSettings {
+	bool enabled = true;
+	// Test reused results anyway and count the ones that hid a visible instance
+	bool validate = false;
+	// Results that have to agree before they are reused, at most 8
+	uint32_t agreeFrames = 4;
+	// Every instance is tested at least once per this many frames
+	uint32_t refreshPeriod = 16;
+	// World space distance instance bounds and the camera may drift before results are tested again
+	float moveThreshold = 0.01f;
+	// Same for the camera's view direction
+	float turnDegrees = 0.5f;
+	// Camera moves beyond this distance or angle are cuts, every history starts over
+	float cutDistance = 2.0f;
+	float cutDegrees = 30.0f;
+};
+
+// Main view visibility of every instance slot over the last frames, shared by all frame slots.
+// Frames are recorded, latched and submitted in order, so each frame sees the history of the one before it
+class VisibilityCache {
+private:
+	std::shared_ptr<Instance> instance;
+	VisibilityCacheSettings _settings;
+	std::unique_ptr<Buffer> _history;
+	size_t _capacity;
+	uint32_t _frame_index;
+	uint64_t _layout_version;
+	bool _has_reference;
+	bool _cleared;
+	// Frames flagged with VIEW_FLAG_RETEST or VIEW_FLAG_RESET_HISTORY, and those flagged with the latter only.
+	// Histories tested before the latest of them are not reused, whether or not the traversal reached them then
+	uint32_t _epoch;
+	uint32_t _reset_epoch;
+	// Camera the reused results were last tested with
+	glm::mat4 _reference_view;
+	glm::mat4 _reference_projection;
+public:
+	VisibilityCache(std::shared_ptr<Instance> instance, const VisibilityCacheSettings& settings, size_t capacity);
+
+	VisibilityCache(const VisibilityCache&) = delete;
+	VisibilityCache(VisibilityCache&&) = delete;
+
+	// Called when recording a frame, returns the index its staggered tests are scheduled with
+	uint32_t next_frame();
+	// VIEW_FLAG_* bits for the main view of the frame about to be submitted, 'layoutVersion' is the scene's
+	// instance layout it was recorded with
+	uint32_t latch(const glm::mat4& view, const glm::mat4& projection, uint64_t layoutVersion);
+	// True for the first frame recorded, which clears the history so no entry matches an epoch before it is tested
+	bool take_clear();
+
+	// Epochs as of the last latch, for ViewData::historyEpoch and ViewData::resetEpoch of the main view
+	inline uint32_t epoch() const {
+		return _epoch;
+	}
+
+	inline uint32_t reset_epoch() const {
+		return _reset_epoch;
+	}
+
+	inline const VisibilityCacheSettings& settings() const {
+		return _settings;
+	}
+
+	inline const std::unique_ptr<Buffer>& history() const {
+		return _history;
+	}
+
+	// Instance slots the history has room for
+	inline size_t capacity() const {
+		return _capacity;
+	}
+};
+
+#endif //VKOCCLUSIONTEST_VISIBILITYCACHE_H
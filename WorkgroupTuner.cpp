@@ -0,0 +1,147 @@
+#include "WorkgroupTuner.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+static std::filesystem::path tuner_file_name(const vk::PhysicalDeviceProperties& props) {
+	std::stringstream name;
+	name << "workgroups_" << std::hex << std::setfill('0') << std::setw(4) << props.vendorID << "_" << std::setw(4) << props.deviceID
+		 << "_" << std::setw(8) << props.driverVersion << ".txt";
+
+	return name.str();
+}
+
+WorkgroupTuner::WorkgroupTuner(std::shared_ptr<Instance> inst, const std::filesystem::path& directory) : instance(std::move(inst)) {
+	_path = directory / tuner_file_name(instance->physical_device().getProperties());
+	load();
+}
+
+void WorkgroupTuner::load() {
+	std::ifstream file(_path);
+	if (!file) {
+		return;
+	}
+
+	//One "<kernel> <x> <y>" line per kernel
+	std::string name;
+	glm::uvec2 shape;
+	while (file >> name >> shape.x >> shape.y) {
+		if (shape.x > 0 && shape.y > 0) {
+			_winners[name] = shape;
+		}
+	}
+}
+
+bool WorkgroupTuner::save() const {
+	std::error_code ec;
+	std::filesystem::create_directories(_path.parent_path(), ec);
+
+	auto tmpPath = _path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+
+		for(const auto& [name, shape] : _winners) {
+			file << name << " " << shape.x << " " << shape.y << "\n";
+		}
+
+		file.flush();
+		if (!file) {
+			file.close();
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tmpPath, _path, ec);
+	if (ec) {
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+
+	return true;
+}
+
+glm::uvec2 WorkgroupTuner::shape(std::string_view kernel, const std::vector<glm::uvec2>& candidates) {
+	std::lock_guard lock(_mutex);
+
+	auto winner = _winners.find(kernel);
+	if (winner != _winners.end()) {
+		return winner->second;
+	}
+
+	if (candidates.empty()) {
+		throw std::runtime_error("No workgroup candidates for " + std::string(kernel));
+	}
+
+	auto trial = _trials.find(kernel);
+	if (trial == _trials.end()) {
+		if (candidates.size() == 1) {
+			_winners.emplace(kernel, candidates[0]);
+			return candidates[0];
+		}
+
+		trial = _trials.emplace(kernel, Trial { candidates, std::vector<double>(candidates.size(), 0.0), std::vector<uint32_t>(candidates.size(), 0), 0 }).first;
+	}
+
+	return trial->second.candidates[trial->second.current];
+}
+
+void WorkgroupTuner::report(std::string_view kernel, glm::uvec2 shape, double milliseconds) {
+	std::lock_guard lock(_mutex);
+
+	auto it = _trials.find(kernel);
+	if (it == _trials.end()) {
+		return;
+	}
+
+	//Frames in flight may still report the previous candidate, so results are matched by shape
+	auto& trial = it->second;
+	for(size_t i = 0; i < trial.candidates.size(); i++) {
+		if (trial.candidates[i] != shape) {
+			continue;
+		}
+
+		if (trial.samples[i]++ > 0) {
+			trial.totals[i] += milliseconds;
+		}
+	}
+
+	if (trial.samples[trial.current] < WORKGROUP_TUNER_SAMPLES) {
+		return;
+	}
+
+	if (trial.current + 1 < trial.candidates.size()) {
+		trial.current++;
+		return;
+	}
+
+	size_t best = 0;
+	double bestTime = std::numeric_limits<double>::max();
+	for(size_t i = 0; i < trial.candidates.size(); i++) {
+		auto average = trial.totals[i] / std::max(trial.samples[i] - 1, 1U);
+		std::cout << "[WorkgroupTuner] " << kernel << " " << trial.candidates[i].x << "x" << trial.candidates[i].y << ": " << average << "ms" << std::endl;
+		if (average < bestTime) {
+			bestTime = average;
+			best = i;
+		}
+	}
+
+	std::cout << "[WorkgroupTuner] " << kernel << " uses " << trial.candidates[best].x << "x" << trial.candidates[best].y << std::endl;
+	_winners.emplace(kernel, trial.candidates[best]);
+	_trials.erase(it);
+
+	if (!save()) {
+		std::cerr << "[WorkgroupTuner] Failed to write " << _path << std::endl;
+	}
+}
+
+bool WorkgroupTuner::tuning() const {
+	std::lock_guard lock(_mutex);
+	return !_trials.empty();
+}
@@ -0,0 +1,53 @@
+#ifndef VKOCCLUSIONTEST_WORKGROUPTUNER_H
+#define VKOCCLUSIONTEST_WORKGROUPTUNER_H
+
+#include <glm/glm.hpp>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Instance.h"
+
+// Frames timed per candidate shape, the first one of each is dropped as warm-up
+#define WORKGROUP_TUNER_SAMPLES 16
+
+// Picks the fastest workgroup shape of each tunable compute kernel on this device.
+// While a kernel is being tuned every frame runs it with the current candidate and reports its GPU time back,
+// once every candidate has been timed the winner is kept and written to disk, so later runs skip tuning.
+class WorkgroupTuner {
+private:
+	struct Trial {
+		std::vector<glm::uvec2> candidates;
+		std::vector<double> totals;
+		std::vector<uint32_t> samples;
+		size_t current;
+	};
+
+	std::shared_ptr<Instance> instance;
+	std::filesystem::path _path;
+	std::map<std::string, glm::uvec2, std::less<>> _winners;
+	std::map<std::string, Trial, std::less<>> _trials;
+	mutable std::mutex _mutex;
+
+	void load();
+	bool save() const;
+public:
+	WorkgroupTuner(std::shared_ptr<Instance> inst, const std::filesystem::path& directory);
+
+	// Shape to record 'kernel' with. 'candidates' are only used the first time a kernel without a stored winner is seen
+	glm::uvec2 shape(std::string_view kernel, const std::vector<glm::uvec2>& candidates);
+	// GPU time of one dispatch round of 'kernel' recorded with 'shape'
+	void report(std::string_view kernel, glm::uvec2 shape, double milliseconds);
+
+	// Some kernel is still being tuned
+	bool tuning() const;
+
+	inline const std::filesystem::path& path() const {
+		return _path;
+	}
+};
+
+#endif //VKOCCLUSIONTEST_WORKGROUPTUNER_H
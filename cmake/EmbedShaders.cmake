@@ -0,0 +1,50 @@
+# Generates a C++ source that embeds compiled SPIR-V modules as constexpr uint32_t arrays.
+# Usage: cmake -DOUTPUT=<file.cpp> -DSHADERS=<a.spv,b.spv,...> -P EmbedShaders.cmake
+# SHADERS is comma separated so the list survives being passed through add_custom_command.
+
+if(NOT OUTPUT OR NOT SHADERS)
+	message(FATAL_ERROR "EmbedShaders.cmake requires OUTPUT and SHADERS")
+endif()
+
+string(REPLACE "," ";" SHADER_LIST "${SHADERS}")
+
+# CMake regexes have no {n} repetition, so spell out one line worth of words
+set(WORDS_PER_LINE_PATTERN "")
+foreach(I RANGE 1 7)
+	string(APPEND WORDS_PER_LINE_PATTERN "0x[0-9a-f]+, ")
+endforeach()
+string(APPEND WORDS_PER_LINE_PATTERN "0x[0-9a-f]+,")
+
+set(ARRAYS "")
+set(ENTRIES "")
+foreach(SHADER IN LISTS SHADER_LIST)
+	get_filename_component(SHADER_NAME ${SHADER} NAME)
+	string(MAKE_C_IDENTIFIER ${SHADER_NAME} SHADER_SYMBOL)
+
+	file(SIZE ${SHADER} SHADER_SIZE)
+	math(EXPR SHADER_REMAINDER "${SHADER_SIZE} % 4")
+	if(SHADER_SIZE EQUAL 0 OR NOT SHADER_REMAINDER EQUAL 0)
+		message(FATAL_ERROR "${SHADER} is not a valid SPIR-V module")
+	endif()
+
+	# SPIR-V words are little endian: swap every group of 4 bytes into a 32 bit literal
+	file(READ ${SHADER} SHADER_HEX HEX)
+	string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1, " SHADER_WORDS "${SHADER_HEX}")
+	string(REGEX REPLACE "(${WORDS_PER_LINE_PATTERN}) " "\\1\n\t" SHADER_WORDS "${SHADER_WORDS}")
+	string(REGEX REPLACE "[ \n\t]+$" "" SHADER_WORDS "${SHADER_WORDS}")
+
+	string(APPEND ARRAYS "alignas(16) constexpr uint32_t ${SHADER_SYMBOL}[] = {\n\t${SHADER_WORDS}\n};\n\n")
+	string(APPEND ENTRIES "\tEmbeddedShader { \"${SHADER_NAME}\", ${SHADER_SYMBOL} },\n")
+endforeach()
+
+set(CONTENT "// Generated by cmake/EmbedShaders.cmake, do not edit\n#include \"EmbeddedShaders.h\"\n#include <array>\n\nnamespace {\n\n${ARRAYS}constexpr std::array shaders {\n${ENTRIES}};\n\n}\n\nstd::span<const uint32_t> find_embedded_shader(std::string_view name) {\n\tfor(const auto& s : shaders) {\n\t\tif (s.name == name) {\n\t\t\treturn s.code;\n\t\t}\n\t}\n\n\treturn {};\n}\n")
+
+# Only touch the output when it actually changed, to avoid needless recompiles
+if(EXISTS ${OUTPUT})
+	file(READ ${OUTPUT} OLD_CONTENT)
+	if(OLD_CONTENT STREQUAL CONTENT)
+		return()
+	endif()
+endif()
+
+file(WRITE ${OUTPUT} "${CONTENT}")
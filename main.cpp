@@ -2,12 +2,19 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_vulkan.h>
 #include <vulkan/vulkan.hpp>
 #include <filesystem>
 #include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <optional>
+#include <cmath>
+#include <algorithm>
 #include "Buffer.h"
 #include "Instance.h"
 #include "Swapchain.h"
@@ -16,8 +23,15 @@
 #include "PipelineCollection.h"
 #include "FrameData.h"
 #include "Texture.h"
+#include "TextureFile.h"
 #include "ComputePipeline.h"
 #include "Sampler.h"
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include "FrameScheduler.h"
+#include <string>
+#include <string_view>
+#include <stb_image.h>
 
 void printSdlError(const char* file, int line) {
 	const char* err = SDL_GetError();
@@ -38,7 +52,254 @@ void cleanup(SDL_Window* window) {
 
 #define CLEANUP() cleanup(window)
 
-int main() {
+FrameSchedulerSettings parseFrameSettings(int argc, char** argv) {
+	FrameSchedulerSettings settings;
+	std::optional<uint32_t> cpuAhead;
+
+	for(int i = 1; i < argc; i++) {
+		std::string_view arg(argv[i]);
+
+		if (arg.starts_with("--frames-in-flight=")) {
+			settings.framesInFlight = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+		} else if (arg.starts_with("--cpu-ahead=")) {
+			cpuAhead = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+		} else if (arg == "--scene-buffers=device-local") {
+			settings.frame.sceneBufferPlacement = BufferPlacement::eDeviceLocal;
+		} else if (arg == "--scene-buffers=host-visible") {
+			settings.frame.sceneBufferPlacement = BufferPlacement::eHostVisible;
+		} else if (arg == "--no-draw-count") {
+			settings.frame.compactDraws = false;
+		} else if (arg.starts_with("--record-threads=")) {
+			settings.recordThreads = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+		} else if (arg == "--no-direct-present") {
+			settings.frame.directPresent = false;
+		} else if (arg.starts_with("--shadow-cascades=")) {
+			settings.frame.secondaryViews = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+		} else if (arg.starts_with("--hzb-size=")) {
+			//WIDTHxHEIGHT, used whatever the window size
+			auto value = std::string(arg.substr(arg.find('=') + 1));
+			settings.frame.hzb.sizing = HZBSizing::eFixed;
+			settings.frame.hzb.fixedSize = { std::stoi(value), std::stoi(value.substr(value.find('x') + 1)) };
+		} else if (arg.starts_with("--hzb-divisor=")) {
+			settings.frame.hzb.sizing = HZBSizing::eFraction;
+			settings.frame.hzb.divisor = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+		} else if (arg.starts_with("--hzb-budget-mib=")) {
+			settings.frame.hzb.sizing = HZBSizing::eBudget;
+			settings.frame.hzb.budget = std::stoull(std::string(arg.substr(arg.find('=') + 1))) * 1024 * 1024;
+		} else if (arg == "--no-bvh") {
+			settings.frame.hierarchicalCulling = false;
+		} else if (arg == "--no-visibility-cache") {
+			settings.visibility.enabled = false;
+		} else if (arg == "--validate-visibility-cache") {
+			//Also tests reused results to count those that were wrong, while the camera follows a path with cuts
+			settings.visibility.validate = true;
+		} else if (arg.starts_with("--visibility-agree=")) {
+			settings.visibility.agreeFrames = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+		} else if (arg.starts_with("--visibility-refresh=")) {
+			settings.visibility.refreshPeriod = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+		}
+	}
+
+	settings.maxCpuAhead = cpuAhead.value_or(settings.framesInFlight);
+	return settings;
+}
+
+bool hasArgument(int argc, char** argv, std::string_view name) {
+	return std::any_of(argv + 1, argv + argc, [name](const char* arg) { return name == arg; });
+}
+
+std::optional<std::string> parseStringArgument(int argc, char** argv, std::string_view name) {
+	for(int i = 1; i < argc; i++) {
+		std::string_view arg(argv[i]);
+		if (arg.starts_with(name) && arg.size() > name.size() && arg[name.size()] == '=') {
+			return std::string(arg.substr(name.size() + 1));
+		}
+	}
+
+	return std::nullopt;
+}
+
+uint32_t parseUintArgument(int argc, char** argv, std::string_view name) {
+	for(int i = 1; i < argc; i++) {
+		std::string_view arg(argv[i]);
+		if (arg.starts_with(name) && arg.size() > name.size() && arg[name.size()] == '=') {
+			return std::stoul(std::string(arg.substr(name.size() + 1)));
+		}
+	}
+
+	return 0;
+}
+
+//Non indexed UV sphere of radius 0.5, segments * segments * 6 vertices
+std::vector<Vertex> generateSphere(uint32_t segments) {
+	auto point = [segments](uint32_t x, uint32_t y) {
+		float theta = glm::two_pi<float>() * x / segments;
+		float phi = glm::pi<float>() * y / segments;
+		glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+
+		Vertex v(normal * 0.5f, normal);
+		v.vertexColor = { 1, 1, 1, 1 };
+		return v;
+	};
+
+	std::vector<Vertex> vertices;
+	vertices.reserve(segments * segments * 6);
+	for(uint32_t y = 0; y < segments; y++) {
+		for(uint32_t x = 0; x < segments; x++) {
+			vertices.push_back(point(x, y));
+			vertices.push_back(point(x, y + 1));
+			vertices.push_back(point(x + 1, y + 1));
+
+			vertices.push_back(point(x, y));
+			vertices.push_back(point(x + 1, y + 1));
+			vertices.push_back(point(x + 1, y));
+		}
+	}
+
+	return vertices;
+}
+
+//RGBA8 checker of 'cells' squares per side, for the generated material textures
+std::vector<uint8_t> generateChecker(uint32_t size, uint32_t cells) {
+	std::vector<uint8_t> pixels(size * size * 4);
+	for(uint32_t y = 0; y < size; y++) {
+		for(uint32_t x = 0; x < size; x++) {
+			uint8_t value = ((x * cells / size) + (y * cells / size)) % 2 == 0 ? 255 : 96;
+			auto pixel = pixels.data() + (y * size + x) * 4;
+			pixel[0] = value;
+			pixel[1] = value;
+			pixel[2] = value;
+			pixel[3] = 255;
+		}
+	}
+
+	return pixels;
+}
+
+//Texture for a material, nullptr when it can't be used. KTX2 and DDS files are uploaded as stored, block compressed
+//formats and every mip level included. Other images are decoded to a single RGBA8 level, as the comparison point
+std::unique_ptr<Texture> loadMaterialTexture(const std::shared_ptr<Instance>& instance, const std::filesystem::path& path, const vk::CommandBuffer& cmd) {
+	auto start = std::chrono::steady_clock::now();
+	auto usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+	std::unique_ptr<Texture> texture;
+
+	auto extension = path.extension().string();
+	if (extension == ".ktx2" || extension == ".dds") {
+		try {
+			auto file = TextureFile::load(path);
+			if (texture_format_block_compressed(file.format()) && !instance->bc_compression_supported()) {
+				std::cerr << "[Textures] " << path << " is block compressed, which the device does not support" << std::endl;
+				return nullptr;
+			}
+
+			auto maxDimension = static_cast<int>(std::min<uint32_t>(instance->physical_device().getProperties().limits.maxImageDimension2D, INT32_MAX));
+			if (file.size().x > maxDimension || file.size().y > maxDimension) {
+				std::cerr << "[Textures] " << path << " is larger than the device's " << maxDimension << " texels per side" << std::endl;
+				return nullptr;
+			}
+
+			texture = std::make_unique<Texture>(instance, file.format(), usage, file.size(), static_cast<uint32_t>(file.levels().size()));
+			if (!texture->fill_from_texture_file(cmd, file)) {
+				std::cerr << "[Textures] Failed to load " << path << std::endl;
+				return nullptr;
+			}
+		} catch (const std::exception& e) {
+			std::cerr << "[Textures] Failed to load " << path << ": " << e.what() << std::endl;
+			return nullptr;
+		}
+	} else {
+		int width = 0, height = 0, channels = 0;
+		if (!stbi_info(path.string().c_str(), &width, &height, &channels)) {
+			std::cerr << "[Textures] Failed to load " << path << std::endl;
+			return nullptr;
+		}
+
+		texture = std::make_unique<Texture>(instance, vk::Format::eR8G8B8A8Unorm, usage, glm::ivec2(width, height), 1);
+		if (!texture->fill_from_file(cmd, path, 0)) {
+			std::cerr << "[Textures] Failed to load " << path << std::endl;
+			return nullptr;
+		}
+	}
+
+	//Load time covers reading, decoding and staging, the copy itself runs on the GPU later
+	auto loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+	std::cout << "[Textures] " << path.filename().string() << ": " << vk::to_string(texture->format()) << ", " << texture->size().x << "x" << texture->size().y
+			  << ", " << texture->levels() << " levels, " << texture->memory_requirements().size / 1024 << " KiB VRAM, loaded in " << loadTime.count() << "ms" << std::endl;
+
+	return texture;
+}
+
+//Camera path for --validate-visibility-cache. It looks at the scene from the start, cuts to a point beside it facing away,
+//so the traversal rejects the leaves in front, then pans back slowly enough that most frames are neither retested nor reset.
+//Instances re-enter the candidates with results from before the cut and another position, any of them reused wrongly
+//shows up as a stale result
+glm::mat4 visibilityValidationView(uint64_t frame) {
+	const uint64_t lookFrames = 240;
+	const uint64_t panFrames = 480;
+
+	auto step = frame % (lookFrames + panFrames);
+	if (step < lookFrames) {
+		return glm::lookAt(glm::vec3(0, 0, 0), {0, 0, -1}, {0, 1, 0});
+	}
+
+	//From facing +Z, away from the scene, to facing -Z through -X, at less than a default turn threshold per frame
+	glm::vec3 eye(4, 0.5f, -1);
+	auto angle = -glm::pi<float>() * static_cast<float>(step - lookFrames) / static_cast<float>(panFrames);
+	return glm::lookAt(eye, eye + glm::vec3(std::sin(angle), 0, std::cos(angle)), {0, 1, 0});
+}
+
+//Orthographic views of a directional light, each one enclosing a slice of the camera frustum.
+//Slices are split logarithmically up to 'distance', casters up to 'distance' towards the light are kept
+std::vector<ViewData> shadowCascadeViews(const UniformData& camera, uint32_t cascades, float distance) {
+	const glm::vec3 lightDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+	const float firstSlice = 0.1f;
+
+	auto cameraToWorld = glm::inverse(camera.view);
+	glm::vec3 eye = cameraToWorld[3];
+	glm::vec3 forward = -glm::vec3(cameraToWorld[2]);
+	glm::vec2 tanHalfFov(1.0f / camera.projection[0][0], 1.0f / camera.projection[1][1]);
+
+	std::vector<ViewData> views;
+	float sliceNear = firstSlice;
+	for(uint32_t i = 0; i < cascades; i++) {
+		float sliceFar = firstSlice * std::pow(distance / firstSlice, (i + 1.0f) / cascades);
+		float middle = (sliceNear + sliceFar) * 0.5f;
+
+		//Sphere on the view axis that reaches the far corners of the slice, stable under camera rotation
+		glm::vec3 center = eye + forward * middle;
+		float radius = glm::length(glm::vec3(tanHalfFov * sliceFar, sliceFar - middle));
+
+		auto view = glm::lookAt(center - lightDirection * distance, center, {0, 1, 0});
+		auto projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, distance + radius);
+		views.push_back(makeView(view, projection));
+
+		sliceNear = sliceFar;
+	}
+
+	return views;
+}
+
+vk::PresentModeKHR parsePresentMode(int argc, char** argv) {
+	for(int i = 1; i < argc; i++) {
+		std::string_view arg(argv[i]);
+		if (!arg.starts_with("--present-mode=")) {
+			continue;
+		}
+
+		auto mode = arg.substr(arg.find('=') + 1);
+		if (mode == "mailbox") {
+			return vk::PresentModeKHR::eMailbox;
+		} else if (mode == "immediate") {
+			return vk::PresentModeKHR::eImmediate;
+		} else if (mode == "fifo-relaxed") {
+			return vk::PresentModeKHR::eFifoRelaxed;
+		}
+	}
+
+	return vk::PresentModeKHR::eFifo;
+}
+
+int main(int argc, char** argv) {
 	SDL_Init(SDL_INIT_VIDEO);
 
 	auto *window = SDL_CreateWindow("vkOcclusionTest", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720,
@@ -51,14 +312,13 @@ int main() {
 	}
 	{
 		auto instance = std::make_shared<Instance>(window);
-		auto swapchain = Swapchain(window, instance);
+		auto swapchain = Swapchain(window, instance, parsePresentMode(argc, argv));
 		instance->create_device(swapchain);
 
-		glm::ivec2 hzbSize = { 1024, 512 };
-
 		int width = 0, height = 0;
 		SDL_Vulkan_GetDrawableSize(window, &width, &height);
 		swapchain.create_swapchain({width, height});
+		std::cout << "[Startup] Present mode: " << vk::to_string(swapchain.present_mode()) << std::endl;
 
 		bool alive = true;
 
@@ -69,9 +329,33 @@ int main() {
 		auto allNearestSampler = Sampler(instance, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest);
 		auto trilinearSampler = Sampler(instance, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear);
 
-		PipelineCollection pipelines(instance, base_path);
+		ThreadPool workers;
+
+		auto pipelineCache = std::make_shared<PipelineCache>(instance, base_path / "cache");
+
+		//Shaders are embedded in the executable, point VKOCCLUSION_SHADER_DIR at a folder of .spv files to override them
+		std::optional<std::filesystem::path> shaderOverridePath;
+		if (auto shaderDir = std::getenv("VKOCCLUSION_SHADER_DIR"); shaderDir != nullptr) {
+			shaderOverridePath = std::filesystem::path(shaderDir);
+		}
+		//--no-minmax-sampler builds and queries the HZB with plain loads even where max reduction is supported, to compare the two
+		PipelineCollection pipelines(instance, pipelineCache, swapchain.surface_format().format, !hasArgument(argc, argv, "--no-minmax-sampler"), shaderOverridePath);
+
+		auto pipelinesStart = std::chrono::steady_clock::now();
+		pipelines.prewarm(workers);
+
+		//Benchmark mesh for vertex heavy scenes, used by the four test objects instead of the quad
+		auto highPolySegments = parseUintArgument(argc, argv, "--high-poly");
+		auto sphere_vertices = generateSphere(highPolySegments);
+
+		//Benchmark scene for hierarchical culling, compare 100k to 1M instances with and without --no-bvh
+		auto cityInstances = parseUintArgument(argc, argv, "--city-instances");
 
-		Scene scene(instance, 1024 * 12, 50 * 1024);
+		//Benchmark scene: one batch per object (through its material), almost all of them hidden behind the test objects
+		auto sparseBatches = parseUintArgument(argc, argv, "--sparse-batches");
+
+		Scene scene(instance, 1024 * 12 + sphere_vertices.size(), 50 * 1024 + cityInstances, pipelines.material_set_layout(), pipelines.material_texture_capacity(),
+					std::max<size_t>(MATERIAL_TABLE_DEFAULT_CAPACITY, sparseBatches + 1));
 
 		std::vector<Vertex> quad_vertices {
 			Vertex({-0.5, -0.5, 0}),
@@ -85,6 +369,7 @@ int main() {
 
 		for(auto& v : quad_vertices) {
 			v.vertexColor = { 1, 1, 1, 1};
+			v.uv = { v.position.x + 0.5f, 0.5f - v.position.y, 0, 0 };
 		}
 
 		auto cmd_buffer = instance->device().allocateCommandBuffers(vk::CommandBufferAllocateInfo(instance->graphics_command_pool(), vk::CommandBufferLevel::ePrimary, 1))[0];
@@ -94,37 +379,109 @@ int main() {
 		cmd_buffer.end();
 		instance->graphics_queue().submit(vk::SubmitInfo(nullptr, nullptr, cmd_buffer, nullptr), load_fence);
 
-		auto objectId = scene.addObject(cube_id, 0);
+		auto test_mesh_id = cube_id;
+		if (!sphere_vertices.empty()) {
+			//Appends share a single transfer buffer, so the quad upload has to finish first
+			instance->device().waitForFences({ load_fence }, true, UINT64_MAX);
+			instance->device().resetFences({ load_fence });
+			cmd_buffer.reset();
+
+			cmd_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+			test_mesh_id = scene.meshes()->append(sphere_vertices, (int)vk::PrimitiveTopology::eTriangleList, {0, 0, 0}, {1, 1, 1}, cmd_buffer);
+			cmd_buffer.end();
+			instance->graphics_queue().submit(vk::SubmitInfo(nullptr, nullptr, cmd_buffer, nullptr), load_fence);
+		}
+
+		//Material 0 is plain white, used by the test objects and the city. Every sparse batch gets its own material,
+		//they all end up in the same texture array and draw, whatever their amount
+		instance->device().waitForFences({ load_fence }, true, UINT64_MAX);
+		instance->device().resetFences({ load_fence });
+		cmd_buffer.reset();
+
+		cmd_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		//--material-texture=PATH replaces the generated checker on every material, so the draw pass time reported on the
+		//[Textures] lines is dominated by sampling it. Compare a converted .ktx2 with its source image across runs
+		std::unique_ptr<Texture> materialTexture;
+		std::string textureLabel;
+		if (auto texturePath = parseStringArgument(argc, argv, "--material-texture"); texturePath.has_value()) {
+			materialTexture = loadMaterialTexture(instance, *texturePath, cmd_buffer);
+			if (materialTexture) {
+				textureLabel = std::filesystem::path(*texturePath).filename().string() + " " + vk::to_string(materialTexture->format()) + ", " +
+							   std::to_string(materialTexture->levels()) + " levels";
+			}
+		}
+		bool texturedMaterials = materialTexture != nullptr;
+		if (!materialTexture) {
+			materialTexture = std::make_unique<Texture>(instance, vk::Format::eR8G8B8A8Unorm, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, glm::ivec2(64, 64), 1);
+			materialTexture->fill_from_data(cmd_buffer, generateChecker(64, 8), 0, 4);
+		}
+		auto material_texture_id = scene.materials()->add_texture(std::move(materialTexture));
+
+		scene.materials()->add_material(glm::vec4(1.0f), texturedMaterials ? material_texture_id : MATERIAL_TEXTURE_NONE, cmd_buffer);
+		for(uint32_t i = 0; i < sparseBatches; i++) {
+			glm::vec4 color(glm::vec3(0.5f) + 0.5f * glm::cos(glm::vec3(0.0f, 2.0f, 4.0f) + 0.37f * i), 1.0f);
+			scene.materials()->add_material(color, texturedMaterials || i % 2 == 0 ? material_texture_id : MATERIAL_TEXTURE_NONE, cmd_buffer);
+		}
+		cmd_buffer.end();
+		instance->graphics_queue().submit(vk::SubmitInfo(nullptr, nullptr, cmd_buffer, nullptr), load_fence);
+
+		auto objectId = scene.addObject(test_mesh_id, 0);
 		auto& obj = scene.get_object(objectId);
 		obj.transform.position({ 0, 0, -2});
 		obj.transform.scale({0.9, 0.9, 0.9});
 
-		objectId = scene.addObject(cube_id, 0);
+		objectId = scene.addObject(test_mesh_id, 0);
 		auto& obj2 = scene.get_object(objectId);
 		obj2.transform.position({ -1, 0, -2});
 		obj2.transform.scale({0.9, 0.9, 0.9});
 
-		objectId = scene.addObject(cube_id, 0);
+		objectId = scene.addObject(test_mesh_id, 0);
 		auto& obj3 = scene.get_object(objectId);
 		obj3.transform.position({ 1, 0, -2});
 		obj3.transform.scale({0.9, 0.9, 0.9});
 
-		objectId = scene.addObject(cube_id, 0);
+		objectId = scene.addObject(test_mesh_id, 0);
 		auto& obj4 = scene.get_object(objectId);
 		obj4.transform.position({ 0, 0, -3});
 		obj4.transform.scale({0.9, 0.9, 0.9});
 
-		auto imageAvailableSemaphore = instance->device().createSemaphore({});
+		auto sparseColumns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(sparseBatches))));
+		for(uint32_t i = 0; i < sparseBatches; i++) {
+			auto& sparseObj = scene.get_object(scene.addObject(cube_id, i + 1));
+			glm::vec2 cell = glm::vec2(i % sparseColumns, i / sparseColumns) / glm::max(1.0f, sparseColumns - 1.0f);
+			float y = i % 16 == 0 ? 2.0f : glm::mix(-1.0f, 1.0f, cell.y);
+			sparseObj.transform.position({ glm::mix(-3.0f, 3.0f, cell.x), y, -6 });
+			sparseObj.transform.scale({0.05, 0.05, 0.05});
+		}
+
+		//Blocks of 16x16 small quads on a ground plane, spreading away from the camera behind the test objects
+		auto cityBlocks = static_cast<uint32_t>(std::ceil(std::sqrt(std::ceil(cityInstances / 256.0f))));
+		for(uint32_t i = 0; i < cityInstances; i++) {
+			auto block = i / 256;
+			glm::vec2 blockCorner = glm::vec2(block % cityBlocks, block / cityBlocks) * 5.0f - glm::vec2(cityBlocks * 2.5f, 0.0f);
+			glm::vec2 cell = glm::vec2(i % 16, (i / 16) % 16) * 0.25f;
+			auto& cityObj = scene.get_object(scene.addObject(cube_id, 0));
+			cityObj.transform.position({ blockCorner.x + cell.x, -1.0f + 0.1f * (i % 7), -4.0f - blockCorner.y - cell.y });
+			cityObj.transform.scale({0.2, 0.2, 0.2});
+		}
+
+		FrameScheduler scheduler(instance, parseFrameSettings(argc, argv), swapchain, pipelines, allNearestSampler, scene.max_objects());
+		scheduler.set_texture_label(textureLabel);
 
-		std::vector<std::unique_ptr<FrameData>> frames;
-		frames.push_back( std::move(std::make_unique<FrameData>(instance, 0, swapchain, hzbSize, pipelines, allNearestSampler)));
-		frames.push_back( std::move(std::make_unique<FrameData>(instance, 1, swapchain, hzbSize, pipelines, allNearestSampler)));
+		{
+			pipelines.wait_prewarm();
+			auto pipelinesTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelinesStart);
+
+			std::cout << "[Startup] Pipelines ready in " << pipelinesTime.count() << "ms on " << workers.size() << " threads ("
+					  << (pipelineCache->loaded_from_disk() ? "warm" : "cold") << " cache)" << std::endl;
+		}
 
 
 		UniformData uniformData(glm::lookAt(glm::vec3(0, 0, 0), {0, 0, -1}, {0, 1, 0}),
 								glm::perspectiveFov(glm::radians(70.0f), 1280.0f, 720.0f, 0.01f, 1000.0f));
 
-		uint32_t imageIndex = 0;
+		bool validateVisibility = scheduler.settings().visibility.enabled && scheduler.settings().visibility.validate;
+		uint64_t frameCount = 0;
 		while (alive) {
 
 			SDL_Event event = {};
@@ -134,48 +491,43 @@ int main() {
 					break;
 				}
 			}
-			auto device = instance->device();
 
-			//Resize swapchain and framebuffers if necessary
+			//Resize the swapchain if necessary, frames in flight keep using the old one until they are done.
+			//Each frame slot recreates its own targets once it is free again
 			SDL_Vulkan_GetDrawableSize(window, &width, &height);
 			glm::ivec2 nSize = {width, height};
 
 			if (nSize != swapchain.size()) {
-				swapchain.create_swapchain(nSize);
+				swapchain.create_swapchain(nSize, &scheduler.deletion_queue());
 			}
 
-			imageIndex = device.acquireNextImageKHR(swapchain.swapchain(), UINT64_MAX, imageAvailableSemaphore,
-													nullptr).value;
-			auto& frame = frames[imageIndex];
-			auto commandBuffer = frame->command_buffer();
-
-			device.waitForFences({ frame->in_flight_fence() }, true, UINT64_MAX);
-			device.resetFences({ frame->in_flight_fence() });
-
+			auto context = scheduler.begin_frame(swapchain);
+			auto commandBuffer = context.frame.command_buffer();
 
-			auto imgs = device.getSwapchainImagesKHR(swapchain.swapchain());
 			commandBuffer.reset();
 
-			uniformData.projection = glm::perspectiveFov(glm::radians(70.0f), (float) width, (float) height, 0.01f,
-																1000.0f);
 			vk::CommandBufferBeginInfo beginInfo({}, nullptr);
 			commandBuffer.begin(beginInfo);
 
-			frame->draw(commandBuffer, scene, uniformData, pipelines, imgs[imageIndex], { width, height });
+			context.frame.draw(commandBuffer, scene, pipelines, context.image, context.view, swapchain.size(), scheduler.record_pool());
 
 			commandBuffer.end();
 
-			vk::PipelineStageFlags waitFlags = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer;
-			instance->graphics_queue().submit(
-					{{imageAvailableSemaphore, waitFlags, commandBuffer, frame->render_in_progress_semaphore()}}, frame->in_flight_fence());
+			//Late latch: sample input and update the camera only once recording is done, right before submitting
+			SDL_PumpEvents();
+			auto latchTime = std::chrono::steady_clock::now();
+			uniformData.projection = glm::perspectiveFov(glm::radians(70.0f), (float) swapchain.size().x, (float) swapchain.size().y, 0.01f,
+														 1000.0f);
+			if (validateVisibility) {
+				uniformData.view = visibilityValidationView(frameCount++);
+			}
+			context.frame.latch_camera(uniformData, shadowCascadeViews(uniformData, context.frame.settings().secondaryViews, 50.0f));
 
-			instance->present_queue().presentKHR({frame->render_in_progress_semaphore(), swapchain.swapchain(), imageIndex});
+			scheduler.end_frame(swapchain, context, latchTime);
 		}
 
 		instance->device().waitIdle();
 
-		instance->device().destroySemaphore(imageAvailableSemaphore);
-
 		instance = nullptr;
 	}
 	CLEANUP();
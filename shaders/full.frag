@@ -1,12 +1,19 @@
 #version 450
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
 #include "libs/structures.glsl"
-/*
-layout(std430, set = 2, binding = 0) buffer MATS {
-	MaterialData materials[];
-};
+#include "libs/references.glsl"
+
+// Every texture of the material library, MaterialData::textureIds index it with an offset of one
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
-layout(set = 2, binding = 1) uniform sampler2D[4] textures;
-*/
+// Same block as the vertex shader, materials are only read here
+layout(push_constant) uniform CNST {
+	VertexBuffer vertexBuffer;
+	VisibleInstanceBuffer visibleBuffer;
+	MaterialBuffer materialBuffer;
+	uint material_count;
+};
 
 layout(location = 0) in vec3 vViewPos;
 layout(location = 1) in vec3 vNormal;
@@ -17,23 +24,29 @@ layout(location = 5) in vec4 vVertexColor;
 layout(location = 6) flat in ivec4 vMaterialMeshBatchId;
 
 layout(location = 0) out vec4 oColor;
-/*
+
 vec4 calcRealColor() {
-	MaterialData mat = materials[vMaterialMeshBatchId.x];
+	// Taken before any branch, so the level of detail is defined whichever materials the quad's fragments end up with
+	vec2 uvDx = dFdx(vUv.xy);
+	vec2 uvDy = dFdy(vUv.xy);
+
+	// Objects whose material was never added are drawn plain white
+	uint materialId = uint(vMaterialMeshBatchId.x);
+	if (materialId >= material_count) {
+		return vVertexColor;
+	}
 
-	vec4 textureFactors = vec4(mat.textureIds.x != 0 ? 1.0 : 0.0, mat.textureIds.y != 0 ? 1.0 : 0.0, mat.textureIds.z != 0 ? 1.0 : 0.0, mat.textureIds.w != 0 ? 1.0 : 0.0);
-	ivec4 textureIds = clamp(mat.textureIds - ivec4(1, 1, 1, 1), ivec4(0, 0, 0, 0), ivec4(3, 3, 3, 3));
+	MaterialData mat = materialBuffer.materials[materialId];
 
-	vec4 val0 = texture(textures[textureIds.x], vUv.xy) * vec4(textureFactors.x);
-	vec4 val1 = texture(textures[textureIds.y], vUv.xy) * vec4(textureFactors.y);
-	vec4 val2 = texture(textures[textureIds.z], vUv.xy) * vec4(textureFactors.z);
-	vec4 val3 = texture(textures[textureIds.w], vUv.xy) * vec4(textureFactors.w);
+	// Draws of different materials may share a subgroup, so the index is not uniform
+	vec4 baseColor = vec4(1.0);
+	if (mat.textureIds.x != 0) {
+		baseColor = textureGrad(textures[nonuniformEXT(mat.textureIds.x - 1)], vUv.xy, uvDx, uvDy);
+	}
 
-	return (val0 + val1 + val2 + val3) * mat.overrideColor * vVertexColor;
+	return baseColor * mat.overrideColor * vVertexColor;
 }
-*/
 
 void main() {
-	//TODO: Actrually use materials and colors...
-	oColor = vVertexColor;
-}
\ No newline at end of file
+	oColor = calcRealColor();
+}
@@ -1,24 +1,20 @@
 #version 450
+#extension GL_EXT_buffer_reference : require
 #include "libs/structures.glsl"
+#include "libs/references.glsl"
 
 precision highp float;
 precision highp int;
 
-layout(std430, set = 0, binding = 0) buffer VTX {
-	Vertex vertices[];
-};
-
-layout(std140, set = 0, binding = 1) uniform UniformBuffer {
+layout(std140, set = 0, binding = 0) uniform UniformBuffer {
 	mat4 view;
 	mat4 projection;
 };
 
-layout(std430, set = 1, binding = 0) buffer INST {
-	ObjectInstance instances[];
-};
-
-layout(std430, set = 1, binding = 1) buffer INDIRECT {
-	uint indirections[];
+// Matrices are precomputed per visible instance by the query pass, the rest of the block is for the fragment shader
+layout(push_constant) uniform CNST {
+	VertexBuffer vertexBuffer;
+	VisibleInstanceBuffer visibleBuffer;
 };
 
 
@@ -31,17 +27,16 @@ layout(location = 5) out vec4 vVerexColor;
 layout(location = 6) flat out ivec4 vMaterialMeshBatchId;
 
 void main() {
-	ObjectInstance instance = instances[indirections[gl_InstanceIndex]];
-	Vertex vertex = vertices[gl_VertexIndex];
-
-	vec4 viewPos = view * instance.model * vec4(vertex.position, 1.0);
-	vViewPos = viewPos.xyz;
-	gl_Position = projection * viewPos;
-	mat4 inverseVM = inverse(view * instance.model);
-	vec4 normal = inverseVM * vec4(vertex.normal, 0.0);
-	vNormal = normal.xyz;
-	vec4 tangent = inverseVM * vec4(vertex.tangent, 0.0);
-	vTangent = tangent.xyz;
+	VisibleInstance instance = visibleBuffer.instances[gl_InstanceIndex];
+	Vertex vertex = vertexBuffer.vertices[gl_VertexIndex];
+
+	vec4 position = vec4(vertex.position, 1.0);
+	gl_Position = instance.mvp * position;
+	vViewPos = vec3(dot(instance.modelView[0], position), dot(instance.modelView[1], position), dot(instance.modelView[2], position));
+
+	mat3 normalMatrix = mat3(instance.normalMatrix[0].xyz, instance.normalMatrix[1].xyz, instance.normalMatrix[2].xyz);
+	vNormal = normalMatrix * vertex.normal;
+	vTangent = vec3(dot(instance.modelView[0].xyz, vertex.tangent), dot(instance.modelView[1].xyz, vertex.tangent), dot(instance.modelView[2].xyz, vertex.tangent));
 	vBiTangent = cross(vNormal, vTangent);
 	vUv = vertex.uv;
 	vVerexColor = vertex.vertexColor;
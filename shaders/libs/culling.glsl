@@ -0,0 +1,127 @@
+// Frustum and HZB tests of boxes, shared by the instance query and the hierarchy traversal.
+// Requires a sampler2D 'hzb' and a bool constant HZB_REDUCTION declared before inclusion
+
+const vec3 corners[8] = vec3[](
+	vec3(-0.5, 0.5, 0.5),
+	vec3(-0.5, -0.5, 0.5),
+	vec3(-0.5, -0.5, -0.5),
+	vec3(-0.5, 0.5, -0.5),
+	vec3(0.5, 0.5, 0.5),
+	vec3(0.5, -0.5, 0.5),
+	vec3(0.5, -0.5, -0.5),
+	vec3(0.5, 0.5, -0.5)
+);
+
+// 'clipped' is set when a corner lies behind the eye, its projection is meaningless then
+vec3[8] getCorners(vec3 bbCenter, vec3 bbSize, mat4 mvp, out bool clipped) {
+	vec3[8] c;
+	clipped = false;
+
+	for (int i = 0; i < 8; i++) {
+		vec4 p4 = mvp * vec4(bbCenter + (bbSize * corners[i]), 1.0);
+		clipped = clipped || p4.w <= 0.0;
+		c[i] = p4.xyz / p4.w;
+
+		c[i] += vec3(1.0, 1.0, 0.0);
+		c[i] *= vec3(0.5, 0.5, 1.0);
+	}
+
+	return c;
+}
+
+bool frustumCull(vec3[8] my_corners) {
+	int outsideLeft = 0, outsideTop = 0, outsideRight = 0, outsideBottom = 0, outsideFront = 0, outsideBack = 0;
+
+	for(int i = 0; i < 8; i++) {
+		vec3 p = my_corners[i];
+
+		outsideLeft += (p.x < 0.0 ? 1 : 0);
+		outsideTop += (p.y > 1.0 ? 1 : 0);
+		outsideRight += (p.x > 1.0 ? 1 : 0);
+		outsideBottom += (p.y < 0.0 ? 1 : 0);
+		outsideFront += + (p.z > 1.0 ? 1 : 0);
+		outsideBack += (p.z < -1.0 ? 1 : 0);
+	}
+
+	return outsideLeft < 8 && outsideTop < 8 && outsideRight < 8 && outsideBottom < 8 && outsideFront < 8 && outsideBack < 8;
+}
+
+// Max depth of every texel the box touches at 'level', where it spans at most two texels on each side.
+// Sampling the corner shared by the first two texels on each side makes the filter reduce exactly those four
+float footprintMaxZ(vec4 sbox_vp, float level) {
+	vec2 a = floor(sbox_vp.xy * exp2(-level));
+	vec2 uv = (a + 1.0) / vec2(textureSize(hzb, int(level)));
+	return textureLod(hzb, uv, level).x;
+}
+
+bool checkHZB(vec4 sbox, float level, float min_z, bool visible) {
+	vec4 samples;
+	samples.x = textureLod(hzb, sbox.xy, level).x;
+	samples.y = textureLod(hzb, sbox.zy, level).x;
+	samples.z = textureLod(hzb, sbox.xw, level).x;
+	samples.w = textureLod(hzb, sbox.zw, level).x;
+
+	float max_z = max(max(samples.x, samples.y), max(samples.z, samples.w));
+	visible = visible && min_z <= max_z;
+
+	return visible;
+}
+
+void GetScreenBounds(vec3[8] my_corners, inout float min_z, inout vec4 sbox) {
+	vec3 p = my_corners[0];
+	sbox = p.xyxy;
+	min_z = p.z;
+
+	for(int i = 1; i < 8; i++) {
+		p = my_corners[i];
+		sbox.xy = min(sbox.xy, p.xy);
+		sbox.zw = max(sbox.zw, p.xy);
+		min_z = min(min_z, p.z);
+	}
+
+}
+
+// 'bbSize' is the full size of the box, 'mvp' takes it to clip space
+bool RunOcclusionCulling(vec3 bbCenter, vec3 bbSize, mat4 mvp, bool occlusion) {
+	bool clipped;
+	vec3[8] my_corners = getCorners(bbCenter, bbSize, mvp, clipped);
+	// Boxes reaching behind the eye are kept, large hierarchy nodes around the camera always are
+	if (clipped) {
+		return true;
+	}
+
+	bool is_visible = frustumCull(my_corners);
+	if (!occlusion || !is_visible) {
+		return is_visible;
+	}
+
+	float min_z = 0.0;
+	vec4 sbox = vec4(0.0);
+
+	GetScreenBounds(my_corners, min_z, sbox);
+	// Only the part on screen can be hidden by what the HZB holds
+	sbox = clamp(sbox, 0.0, 1.0);
+
+	// At this level the box is at most one texel wide, so it touches at most two texels on each side
+	vec4 sbox_vp = sbox * textureSize(hzb, 0).xyxy;
+	vec2 size = sbox_vp.zw - sbox_vp.xy;
+	float level = max(ceil(log2(max(size.x, size.y))), 0.0);
+
+	float level_lower = max(level - 1.0, 0.0);
+	vec2 scale = vec2(exp2(-level_lower));
+	vec2 a = floor(sbox_vp.xy * scale);
+	vec2 b = floor(sbox_vp.zw * scale);
+	vec2 dims = b - a;
+
+	// Use the lower level if we still only touch <= 2 texels in both dimensions.
+	// The four samples below sit on the corners of the box, a third texel in between would be missed
+	if (dims.x <= 1 && dims.y <= 1) {
+		level = level_lower;
+	}
+
+	if (HZB_REDUCTION) {
+		return min_z <= footprintMaxZ(sbox_vp, level);
+	}
+
+	return checkHZB(sbox, level, min_z, is_visible);
+}
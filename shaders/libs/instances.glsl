@@ -0,0 +1,8 @@
+// Helpers for ObjectInstance. Requires libs/structures.glsl
+
+// No flags are defined yet, the field is reserved for per instance options
+#define INSTANCE_FLAG_NONE 0u
+
+mat4 instanceModel(ObjectInstance inst) {
+	return transpose(mat4(inst.model[0], inst.model[1], inst.model[2], vec4(0.0, 0.0, 0.0, 1.0)));
+}
@@ -0,0 +1,70 @@
+// Buffer reference types for storage buffers passed by device address.
+// Requires GL_EXT_buffer_reference and libs/structures.glsl
+
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer VertexBuffer {
+	Vertex vertices[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer InstanceBuffer {
+	ObjectInstance instances[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) buffer VisibleInstanceBuffer {
+	VisibleInstance instances[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 4) buffer IndirectionBuffer {
+	uint indirections[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) buffer CommandBuffer {
+	DrawCommand commands[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer BatchBuffer {
+	DrawBatch batches[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer MeshTableBuffer {
+	MeshData meshes[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer MaterialBuffer {
+	MaterialData materials[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer ViewBuffer {
+	ViewData views[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) buffer VisibilityHistoryBuffer {
+	VisibilityHistory entries[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer BVHNodeBuffer {
+	BVHNode nodes[];
+};
+
+// Instance slots in leaf order, leaves own a range of them
+layout(std430, buffer_reference, buffer_reference_align = 4) readonly buffer LeafInstanceBuffer {
+	uint instances[];
+};
+
+// Nodes to test per hierarchy level, each level appends into the range of the next one
+layout(std430, buffer_reference, buffer_reference_align = 4) buffer NodeQueueBuffer {
+	uint nodes[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 16) buffer DispatchListBuffer {
+	DispatchList lists[];
+};
+
+// Instances of the visible leaves, the query pass is dispatched through 'list'
+layout(std430, buffer_reference, buffer_reference_align = 16) buffer CandidateBuffer {
+	DispatchList list;
+	uint instances[];
+};
+
+layout(std430, buffer_reference, buffer_reference_align = 4) buffer CountBuffer {
+	uint counts[];
+};
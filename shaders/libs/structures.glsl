@@ -28,11 +28,21 @@ struct Vertex {
 	v4 vertexColor;
 };
 
+// 64 bytes, bounds come from the mesh table through meshId
 struct ObjectInstance {
-	align_16 m4 model;
-	i4 materialMeshBatchId; //last component is padding
-	v4 bbCenter; //last component is padding
-	v4 bbSize; //last component is padding
+	align_16 v4 model[3]; //rows of the affine model matrix
+	uint meshId;
+	uint materialId;
+	uint batchId;
+	uint flags; //INSTANCE_FLAG_* bits
+};
+
+// Written by the query pass for every visible instance, at the same index as its indirection
+struct VisibleInstance {
+	align_16 m4 mvp;
+	v4 modelView[3]; //rows of the affine view * model matrix
+	v4 normalMatrix[3]; //columns, last component is padding
+	i4 materialMeshBatchId;
 };
 
 struct UniformData {
@@ -40,16 +50,81 @@ struct UniformData {
 	m4 projection;
 };
 
+// Only views rendered from where the HZB was built, the main camera, may test against it
+#define VIEW_FLAG_NONE 0u
+#define VIEW_FLAG_OCCLUSION 1u
+// The camera moved, cached visibility of the main view can't be reused this frame
+#define VIEW_FLAG_RETEST 2u
+// Camera cut or new instance layout, the history of every instance starts over
+#define VIEW_FLAG_RESET_HISTORY 4u
+
+// View the query pass culls against, every instance is tested against all of them
+struct ViewData {
+	align_16 m4 view;
+	m4 projection;
+	uint flags; //VIEW_FLAG_* bits
+	uint historyEpoch; //main view only, counts the frames flagged with VIEW_FLAG_RETEST or VIEW_FLAG_RESET_HISTORY
+	uint resetEpoch; //main view only, counts the frames flagged with VIEW_FLAG_RESET_HISTORY
+	uint padding0;
+};
+
+// Texture ids index the bindless texture array with an offset of one, 0 means no texture
 struct MaterialData {
 	align_16 v4 overrideColor;
-	i4 textureIds;
+	i4 textureIds; //x is the base color, the others are unused
 };
 
 struct DrawBatch {
 	align_16 int meshId;
 	int materialId;
 	int amount;
+	int firstInstance;
+};
+
+struct MeshData {
+	align_16 int vertexAmount;
+	int vertexOffset;
+	int meshType;
 	int padding;
+	v4 bbCenter; //last component is padding
+	v4 bbExtents; //last component is padding
+};
+
+// Query pass options for the visibility history
+#define HISTORY_FLAG_NONE 0u
+#define HISTORY_FLAG_ENABLED 1u
+// Reused results are tested anyway and counted when they hide a visible instance
+#define HISTORY_FLAG_VALIDATE 2u
+
+// Main view visibility of an instance over the last frames it was tested, kept across frames
+struct VisibilityHistory {
+	align_16 v4 bounds; //world space bounding sphere the results were found for
+	uint results; //bit 0 is the latest result
+	uint tested; //results since the history started over, saturates
+	uint epoch; //ViewData::historyEpoch of the frame it was last tested in
+	uint resetEpoch; //ViewData::resetEpoch of the frame it was last tested in
+};
+
+#define BVH_NODE_NONE 0u
+// 'first' and 'count' address the leaf instances instead of child nodes
+#define BVH_NODE_LEAF 1u
+
+// Node of the instance hierarchy, bounds are in world space
+struct BVHNode {
+	align_16 v4 boundsMin; //last component is padding
+	v4 boundsMax; //last component is padding
+	uint first; //first child node, or first entry of the leaf instances
+	uint count; //children, or instances of a leaf
+	uint flags; //BVH_NODE_* bits
+	uint padding;
+};
+
+// Append list dispatched indirectly, the first three fields are a VkDispatchIndirectCommand covering 'count'
+struct DispatchList {
+	align_16 uint groupsX;
+	uint groupsY;
+	uint groupsZ;
+	uint count;
 };
 
 struct DrawCommand {
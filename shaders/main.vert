@@ -1,29 +1,29 @@
 #version 450
+#extension GL_EXT_buffer_reference : require
 #include "libs/structures.glsl"
+#include "libs/references.glsl"
+#include "libs/instances.glsl"
 
 precision highp float;
 precision highp int;
 
-layout(std430, set = 0, binding = 0) buffer VTX {
-	Vertex vertices[];
-};
-
-layout(std140, set = 0, binding = 1) uniform UniformBuffer {
+layout(std140, set = 0, binding = 0) uniform UniformBuffer {
 	mat4 view;
 	mat4 projection;
 };
 
-layout(std430, set = 1, binding = 0) buffer INST {
-	ObjectInstance instances[];
+layout(push_constant) uniform CNST {
+	VertexBuffer vertexBuffer;
+	InstanceBuffer instanceBuffer;
 };
 
 
 layout(location = 0) out vec4 vVertexColor;
 
 void main() {
-	Vertex v = vertices[gl_VertexIndex];
-	mat4 model = instances[gl_InstanceIndex].model;
+	Vertex v = vertexBuffer.vertices[gl_VertexIndex];
+	mat4 model = instanceModel(instanceBuffer.instances[gl_InstanceIndex]);
 
 	gl_Position = projection * view * model * vec4(v.position, 1.0);
 	vVertexColor = v.vertexColor;
-}
\ No newline at end of file
+}
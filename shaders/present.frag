@@ -0,0 +1,14 @@
+#version 450
+
+precision highp float;
+precision highp int;
+
+// Rendered frame, same size as the swapchain image this pass writes
+layout(set = 0, binding = 0) uniform sampler2D frameColor;
+
+layout(location = 0) out vec4 oColor;
+
+void main() {
+	//Post processing goes here, the result is written straight into the swapchain image
+	oColor = texelFetch(frameColor, ivec2(gl_FragCoord.xy), 0);
+}
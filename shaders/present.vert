@@ -0,0 +1,10 @@
+#version 450
+
+precision highp float;
+precision highp int;
+
+// Single triangle covering the whole target, drawn without vertex buffers
+void main() {
+	vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}